@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GLOG_MODULE_DEFINE("binder-bench");
+
+static const BinderNfcBenchCmd* const binder_nfc_bench_cmds[] = {
+    &binder_nfc_bench_hal,
+    &binder_nfc_bench_dispatch,
+    &binder_nfc_bench_sched,
+    &binder_nfc_bench_watch
+};
+
+/*==========================================================================*
+ * Reporting
+ *==========================================================================*/
+
+static
+int
+binder_nfc_bench_compare(
+    gconstpointer a,
+    gconstpointer b)
+{
+    const gint64 x = *(const gint64*)a;
+    const gint64 y = *(const gint64*)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+static
+gint64
+binder_nfc_bench_percentile(
+    const gint64* sorted,
+    guint count,
+    guint permille)
+{
+    guint i = (guint)(((guint64)count * permille) / 1000);
+
+    return sorted[MIN(i, count - 1)];
+}
+
+void
+binder_nfc_bench_report(
+    const char* title,
+    gint64* samples,
+    guint count,
+    gint64 total_us)
+{
+    if (count) {
+        qsort(samples, count, sizeof(samples[0]), binder_nfc_bench_compare);
+        printf("%s: %u samples in %" G_GINT64_FORMAT " us\n", title, count,
+            total_us);
+        printf("  min    %8" G_GINT64_FORMAT " us\n", samples[0]);
+        printf("  p50    %8" G_GINT64_FORMAT " us\n",
+            binder_nfc_bench_percentile(samples, count, 500));
+        printf("  p99    %8" G_GINT64_FORMAT " us\n",
+            binder_nfc_bench_percentile(samples, count, 990));
+        printf("  p999   %8" G_GINT64_FORMAT " us\n",
+            binder_nfc_bench_percentile(samples, count, 999));
+        printf("  max    %8" G_GINT64_FORMAT " us\n", samples[count - 1]);
+        if (total_us > 0) {
+            printf("  rate   %8.1f packets/sec\n",
+                count * (double)G_USEC_PER_SEC / total_us);
+        }
+    } else {
+        printf("%s: no samples\n", title);
+    }
+}
+
+/*==========================================================================*
+ * Main
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_usage(
+    const char* exe)
+{
+    guint i;
+
+    printf("Usage: %s COMMAND [OPTIONS]\n\nCommands:\n", exe);
+    for (i = 0; i < G_N_ELEMENTS(binder_nfc_bench_cmds); i++) {
+        const BinderNfcBenchCmd* cmd = binder_nfc_bench_cmds[i];
+
+        printf("  %-12s %s\n", cmd->name, cmd->summary);
+    }
+    printf("\nUse \"%s COMMAND --help\" for command options.\n", exe);
+}
+
+int
+main(
+    int argc,
+    char* argv[])
+{
+    if (argc > 1) {
+        guint i;
+
+        for (i = 0; i < G_N_ELEMENTS(binder_nfc_bench_cmds); i++) {
+            const BinderNfcBenchCmd* cmd = binder_nfc_bench_cmds[i];
+
+            if (!strcmp(argv[1], cmd->name)) {
+                return cmd->run(argc - 1, argv + 1);
+            }
+        }
+    }
+    binder_nfc_bench_usage(argv[0]);
+    return RET_CMDLINE;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "bench.h"
+#include "binder_nfc_api_impl.h"
+
+#include <glib-object.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Compares the cost of delivering an inbound packet through the api's
+ * plain handler list with the cost of the equivalent GSignal emission
+ * (POINTER + ULONG arguments) which was used before.
+ */
+
+#define DEFAULT_COUNT       1000000
+#define DEFAULT_HANDLERS    1
+
+typedef GObjectClass BinderNfcBenchEmitterClass;
+typedef struct binder_nfc_bench_emitter {
+    GObject object;
+} BinderNfcBenchEmitter;
+
+#define EMITTER_TYPE binder_nfc_bench_emitter_get_type()
+#define SIGNAL_DATA_NAME "bench-data"
+
+G_DEFINE_TYPE(BinderNfcBenchEmitter, binder_nfc_bench_emitter, G_TYPE_OBJECT)
+
+static guint binder_nfc_bench_emitter_signal_data = 0;
+
+typedef struct binder_nfc_bench_dispatch_opt {
+    int count;
+    int handlers;
+} BinderNfcBenchDispatchOpt;
+
+/*==========================================================================*
+ * Emitter
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_emitter_init(
+    BinderNfcBenchEmitter* self)
+{
+}
+
+static
+void
+binder_nfc_bench_emitter_class_init(
+    BinderNfcBenchEmitterClass* klass)
+{
+    binder_nfc_bench_emitter_signal_data =
+        g_signal_new(SIGNAL_DATA_NAME, G_OBJECT_CLASS_TYPE(klass),
+            G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL,
+            G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_ULONG);
+}
+
+/*==========================================================================*
+ * Handlers
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_dispatch_signal_handler(
+    BinderNfcBenchEmitter* emitter,
+    const void* data,
+    gsize size,
+    gpointer user_data)
+{
+    *(gsize*)user_data += size;
+}
+
+static
+void
+binder_nfc_bench_dispatch_data_handler(
+    BinderNfcApi* api,
+    const void* data,
+    gsize size,
+    gpointer user_data)
+{
+    *(gsize*)user_data += size;
+}
+
+/*==========================================================================*
+ * Benchmark
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_dispatch_report(
+    const char* title,
+    guint count,
+    gint64 total_us)
+{
+    printf("%-8s %u calls in %" G_GINT64_FORMAT " us, %.1f ns/call\n",
+        title, count, total_us, total_us * 1000.0 / count);
+}
+
+static
+int
+binder_nfc_bench_dispatch_measure(
+    const BinderNfcBenchDispatchOpt* opt)
+{
+    static const guint8 packet[] = { 0x00, 0x00, 0x02, 0x90, 0x00 };
+    BinderNfcBenchEmitter* emitter = g_object_new(EMITTER_TYPE, NULL);
+    BinderNfcApi* api = g_object_new(BINDER_NFC_TYPE_API, NULL);
+    gulong* ids = g_new(gulong, opt->handlers);
+    gsize signal_bytes = 0, direct_bytes = 0;
+    gint64 start;
+    int i;
+
+    for (i = 0; i < opt->handlers; i++) {
+        g_signal_connect(emitter, SIGNAL_DATA_NAME,
+            G_CALLBACK(binder_nfc_bench_dispatch_signal_handler),
+            &signal_bytes);
+        ids[i] = binder_nfc_api_add_data_handler(api,
+            binder_nfc_bench_dispatch_data_handler, &direct_bytes);
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < opt->count; i++) {
+        g_signal_emit(emitter, binder_nfc_bench_emitter_signal_data, 0,
+            packet, (gulong) sizeof(packet));
+    }
+    binder_nfc_bench_dispatch_report("gsignal", opt->count,
+        g_get_monotonic_time() - start);
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < opt->count; i++) {
+        binder_nfc_api_emit_data(api, packet, sizeof(packet));
+    }
+    binder_nfc_bench_dispatch_report("direct", opt->count,
+        g_get_monotonic_time() - start);
+
+    for (i = 0; i < opt->handlers; i++) {
+        binder_nfc_api_remove_handler(api, ids[i]);
+    }
+    g_free(ids);
+    g_object_unref(api);
+    g_object_unref(emitter);
+
+    /* Make sure that both paths have actually delivered everything */
+    if (signal_bytes == direct_bytes &&
+        signal_bytes == (gsize) opt->count * opt->handlers * sizeof(packet)) {
+        return RET_OK;
+    } else {
+        GERR("Delivery mismatch");
+        return RET_ERR;
+    }
+}
+
+static
+int
+binder_nfc_bench_dispatch_run(
+    int argc,
+    char* argv[])
+{
+    int ret = RET_CMDLINE;
+    BinderNfcBenchDispatchOpt opt;
+    GOptionContext* options;
+    GError* error = NULL;
+    GOptionEntry entries[] = {
+        { "count", 'n', 0, G_OPTION_ARG_INT, &opt.count,
+          "Number of packets to dispatch [" G_STRINGIFY(DEFAULT_COUNT)
+          "]", "N" },
+        { "handlers", 'H', 0, G_OPTION_ARG_INT, &opt.handlers,
+          "Number of handlers [" G_STRINGIFY(DEFAULT_HANDLERS) "]", "N" },
+        { NULL }
+    };
+
+    memset(&opt, 0, sizeof(opt));
+    opt.count = DEFAULT_COUNT;
+    opt.handlers = DEFAULT_HANDLERS;
+
+    options = g_option_context_new("- compare inbound data dispatch paths");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error) && argc == 1 &&
+        opt.count > 0 && opt.handlers > 0) {
+        ret = binder_nfc_bench_dispatch_measure(&opt);
+    } else if (error) {
+        GERR("%s", error->message);
+        g_error_free(error);
+    } else {
+        char* help = g_option_context_get_help(options, TRUE, NULL);
+
+        fprintf(stderr, "%s", help);
+        g_free(help);
+    }
+    g_option_context_free(options);
+    return ret;
+}
+
+const BinderNfcBenchCmd binder_nfc_bench_dispatch = {
+    "dispatch",
+    "Inbound data dispatch, GSignal vs handler list",
+    binder_nfc_bench_dispatch_run
+};
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,695 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "bench.h"
+#include "binder_nfc_api.h"
+#include "binder_nfc_api_aidl.h"
+#include "binder_nfc_api_hidl.h"
+
+#include <gbinder.h>
+
+#include <glib-unix.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Loopback benchmark. A child process registers a fake INfc service
+ * which echoes every written packet back through sendData(). The parent
+ * talks to it through the same BinderNfcApi objects the plugin uses and
+ * measures write-to-echo round trip time.
+ */
+
+#define DEFAULT_INSTANCE    "bench"
+#define DEFAULT_COUNT       10000
+#define DEFAULT_WARMUP      100
+#define DEFAULT_SIZE        32
+#define SERVICE_WAIT_MS     5000
+#define SERVICE_POLL_MS     20
+
+/* Shared by both HIDL and AIDL flavors of INfcClientCallback */
+#define EVENT_OPEN_CPLT     0
+#define EVENT_CLOSE_CPLT    1
+
+typedef struct binder_nfc_bench_hal_backend {
+    const char* name;
+    const char* dev;
+    const char* iface;
+    const char* callback_iface;
+    guint req_open;
+    guint req_close;
+    guint req_core_initialized;
+    guint req_prediscover;
+    guint req_write;
+    guint callback_send_event;
+    guint callback_send_data;
+    const void* (*read_data)(GBinderReader* reader, gsize* len);
+    void (*write_data)(GBinderWriter* writer, const void* data, gsize len);
+    BinderNfcApi* (*api)(GBinderRemoteObject* remote);
+} BinderNfcBenchHalBackend;
+
+typedef struct binder_nfc_bench_hal_service {
+    const BinderNfcBenchHalBackend* backend;
+    GBinderClient* callback;
+} BinderNfcBenchHalService;
+
+typedef struct binder_nfc_bench_hal_opt {
+    const char* instance;
+    int count;
+    int warmup;
+    int size;
+} BinderNfcBenchHalOpt;
+
+typedef struct binder_nfc_bench_hal {
+    const BinderNfcBenchHalOpt* opt;
+    GMainLoop* loop;
+    BinderNfcApi* api;
+    gulong data_id;
+    guint8* packet;
+    gsize packet_size;
+    gint64* samples;
+    guint done;
+    gint64 start;
+    gint64 end;
+    gint64 sent;
+    gboolean echo_received;
+    gboolean write_completed;
+    int ret;
+} BinderNfcBenchHal;
+
+/*==========================================================================*
+ * Backends
+ *==========================================================================*/
+
+static
+const void*
+binder_nfc_bench_hal_hidl_read(
+    GBinderReader* reader,
+    gsize* len)
+{
+    return gbinder_reader_read_hidl_byte_vec(reader, len);
+}
+
+static
+void
+binder_nfc_bench_hal_hidl_write(
+    GBinderWriter* writer,
+    const void* data,
+    gsize len)
+{
+    gbinder_writer_append_hidl_vec(writer, data, len, 1);
+}
+
+static
+const void*
+binder_nfc_bench_hal_aidl_read(
+    GBinderReader* reader,
+    gsize* len)
+{
+    return gbinder_reader_read_byte_array(reader, len);
+}
+
+static
+void
+binder_nfc_bench_hal_aidl_write(
+    GBinderWriter* writer,
+    const void* data,
+    gsize len)
+{
+    gbinder_writer_append_byte_array(writer, data, len);
+}
+
+static const BinderNfcBenchHalBackend binder_nfc_bench_hal_backends[] = {
+    {
+        "hidl",
+        GBINDER_DEFAULT_HWBINDER,
+        BINDER_NFC_HIDL_IFACE,
+        BINDER_NFC_HIDL_IFACE_("INfcClientCallback"),
+        1, /* open */
+        5, /* close */
+        3, /* coreInitialized */
+        4, /* prediscover */
+        2, /* write */
+        1, /* sendEvent */
+        2, /* sendData */
+        binder_nfc_bench_hal_hidl_read,
+        binder_nfc_bench_hal_hidl_write,
+        binder_nfc_api_hidl_new
+    },{
+        "aidl",
+        GBINDER_DEFAULT_BINDER,
+        BINDER_NFC_AIDL_IFACE,
+        BINDER_NFC_AIDL_IFACE_("INfcClientCallback"),
+        1, /* open */
+        2, /* close */
+        3, /* coreInitialized */
+        7, /* prediscover */
+        8, /* write */
+        2, /* sendEvent */
+        1, /* sendData */
+        binder_nfc_bench_hal_aidl_read,
+        binder_nfc_bench_hal_aidl_write,
+        binder_nfc_api_aidl_new
+    }
+};
+
+#define N_BACKENDS G_N_ELEMENTS(binder_nfc_bench_hal_backends)
+
+/*==========================================================================*
+ * Fake HAL service (runs in the child process)
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_hal_service_send(
+    BinderNfcBenchHalService* service,
+    guint code,
+    GBinderLocalRequest* req) /* gets unref'd */
+{
+    /* Nobody waits for sendEvent/sendData replies */
+    gbinder_client_transact(service->callback, code, 0, req,
+        NULL, NULL, NULL);
+    gbinder_local_request_unref(req);
+}
+
+static
+void
+binder_nfc_bench_hal_service_send_event(
+    BinderNfcBenchHalService* service,
+    guint32 event)
+{
+    if (service->callback) {
+        GBinderLocalRequest* req =
+            gbinder_client_new_request(service->callback);
+
+        gbinder_local_request_append_int32(req, event);
+        gbinder_local_request_append_int32(req, 0 /* status */);
+        binder_nfc_bench_hal_service_send(service,
+            service->backend->callback_send_event, req);
+    }
+}
+
+static
+void
+binder_nfc_bench_hal_service_send_data(
+    BinderNfcBenchHalService* service,
+    const void* data,
+    gsize len)
+{
+    if (service->callback) {
+        GBinderLocalRequest* req =
+            gbinder_client_new_request(service->callback);
+        GBinderWriter writer;
+
+        gbinder_local_request_init_writer(req, &writer);
+        service->backend->write_data(&writer, data, len);
+        binder_nfc_bench_hal_service_send(service,
+            service->backend->callback_send_data, req);
+    }
+}
+
+static
+GBinderLocalReply*
+binder_nfc_bench_hal_service_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    BinderNfcBenchHalService* service = user_data;
+    const BinderNfcBenchHalBackend* backend = service->backend;
+    GBinderLocalReply* reply;
+    GBinderReader reader;
+    gint32 result = 0;
+
+    gbinder_remote_request_init_reader(req, &reader);
+    if (code == backend->req_open) {
+        GBinderRemoteObject* cb = gbinder_reader_read_object(&reader);
+
+        gbinder_client_unref(service->callback);
+        service->callback = cb ? gbinder_client_new(cb,
+            backend->callback_iface) : NULL;
+        gbinder_remote_object_unref(cb);
+        binder_nfc_bench_hal_service_send_event(service, EVENT_OPEN_CPLT);
+    } else if (code == backend->req_write) {
+        gsize len = 0;
+        const void* data = backend->read_data(&reader, &len);
+
+        if (!data) {
+            *status = GBINDER_STATUS_FAILED;
+            return NULL;
+        }
+
+        /* Echo the packet back */
+        binder_nfc_bench_hal_service_send_data(service, data, len);
+        result = (gint32) len;
+    } else if (code == backend->req_close) {
+        binder_nfc_bench_hal_service_send_event(service, EVENT_CLOSE_CPLT);
+        gbinder_client_unref(service->callback);
+        service->callback = NULL;
+    } else if (code != backend->req_core_initialized &&
+        code != backend->req_prediscover) {
+        *status = GBINDER_STATUS_FAILED;
+        return NULL;
+    }
+
+    /* Status followed by the return value */
+    *status = GBINDER_STATUS_OK;
+    reply = gbinder_local_object_new_reply(obj);
+    gbinder_local_reply_append_int32(reply, 0);
+    gbinder_local_reply_append_int32(reply, result);
+    return reply;
+}
+
+static
+gboolean
+binder_nfc_bench_hal_service_quit(
+    gpointer loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+int
+binder_nfc_bench_hal_service_run(
+    const BinderNfcBenchHalBackend* backend,
+    const char* fqname)
+{
+    int ret = RET_ERR;
+    GBinderServiceManager* sm = gbinder_servicemanager_new(backend->dev);
+
+    if (sm) {
+        BinderNfcBenchHalService service;
+        GBinderLocalObject* obj;
+
+        memset(&service, 0, sizeof(service));
+        service.backend = backend;
+        obj = gbinder_servicemanager_new_local_object(sm, backend->iface,
+            binder_nfc_bench_hal_service_handler, &service);
+        if (gbinder_servicemanager_add_service_sync(sm, fqname, obj) ==
+            GBINDER_STATUS_OK) {
+            GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+            guint sigterm = g_unix_signal_add(SIGTERM,
+                binder_nfc_bench_hal_service_quit, loop);
+
+            GDEBUG("Registered %s", fqname);
+            g_main_loop_run(loop);
+            g_source_remove(sigterm);
+            g_main_loop_unref(loop);
+            ret = RET_OK;
+        } else {
+            GERR("Failed to register %s", fqname);
+        }
+        gbinder_local_object_unref(obj);
+        gbinder_client_unref(service.callback);
+        gbinder_servicemanager_unref(sm);
+    }
+    return ret;
+}
+
+/*==========================================================================*
+ * Client side
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_hal_fail(
+    BinderNfcBenchHal* bench,
+    const char* what)
+{
+    GERR("%s failed", what);
+    bench->ret = RET_ERR;
+    g_main_loop_quit(bench->loop);
+}
+
+static
+void
+binder_nfc_bench_hal_close_complete(
+    BinderNfcApi* api,
+    gboolean ok,
+    gpointer user_data)
+{
+    BinderNfcBenchHal* bench = user_data;
+
+    g_main_loop_quit(bench->loop);
+}
+
+static
+void
+binder_nfc_bench_hal_write_complete(
+    BinderNfcApi* api,
+    gboolean ok,
+    gpointer user_data);
+
+static
+void
+binder_nfc_bench_hal_send(
+    BinderNfcBenchHal* bench)
+{
+    GUtilData chunks[2];
+
+    /* Header and payload are separate chunks, the way NCI core writes them */
+    chunks[0].bytes = bench->packet;
+    chunks[0].size = 3;
+    chunks[1].bytes = bench->packet + 3;
+    chunks[1].size = bench->packet_size - 3;
+
+    bench->echo_received = FALSE;
+    bench->write_completed = FALSE;
+    bench->sent = g_get_monotonic_time();
+    if (!binder_nfc_api_write(bench->api, chunks, G_N_ELEMENTS(chunks),
+        binder_nfc_bench_hal_write_complete, NULL, bench)) {
+        binder_nfc_bench_hal_fail(bench, "write");
+    }
+}
+
+static
+void
+binder_nfc_bench_hal_round_trip_check(
+    BinderNfcBenchHal* bench)
+{
+    if (bench->echo_received && bench->write_completed) {
+        const BinderNfcBenchHalOpt* opt = bench->opt;
+        const gint64 now = g_get_monotonic_time();
+        const guint warmup = opt->warmup;
+
+        if (bench->done >= warmup) {
+            bench->samples[bench->done - warmup] = now - bench->sent;
+        }
+        bench->done++;
+        if (bench->done == warmup) {
+            bench->start = now;
+        }
+        if (bench->done < warmup + opt->count) {
+            binder_nfc_bench_hal_send(bench);
+        } else {
+            bench->end = now;
+            if (!binder_nfc_api_close(bench->api, BINDER_NFC_CLOSE_DISABLE,
+                binder_nfc_bench_hal_close_complete, NULL, bench)) {
+                g_main_loop_quit(bench->loop);
+            }
+        }
+    }
+}
+
+static
+void
+binder_nfc_bench_hal_write_complete(
+    BinderNfcApi* api,
+    gboolean ok,
+    gpointer user_data)
+{
+    BinderNfcBenchHal* bench = user_data;
+
+    if (ok) {
+        bench->write_completed = TRUE;
+        binder_nfc_bench_hal_round_trip_check(bench);
+    } else {
+        binder_nfc_bench_hal_fail(bench, "write");
+    }
+}
+
+static
+void
+binder_nfc_bench_hal_data(
+    BinderNfcApi* api,
+    const void* data,
+    gsize size,
+    gpointer user_data)
+{
+    BinderNfcBenchHal* bench = user_data;
+
+    if (size == bench->packet_size &&
+        !memcmp(data, bench->packet, size)) {
+        bench->echo_received = TRUE;
+        binder_nfc_bench_hal_round_trip_check(bench);
+    } else {
+        binder_nfc_bench_hal_fail(bench, "echo");
+    }
+}
+
+static
+void
+binder_nfc_bench_hal_open_complete(
+    BinderNfcApi* api,
+    gboolean ok,
+    gpointer user_data)
+{
+    BinderNfcBenchHal* bench = user_data;
+
+    if (ok) {
+        if (!bench->opt->warmup) {
+            bench->start = g_get_monotonic_time();
+        }
+        binder_nfc_bench_hal_send(bench);
+    } else {
+        binder_nfc_bench_hal_fail(bench, "open");
+    }
+}
+
+static
+GBinderRemoteObject*
+binder_nfc_bench_hal_wait_service(
+    GBinderServiceManager* sm,
+    const char* fqname)
+{
+    const gint64 deadline = g_get_monotonic_time() +
+        SERVICE_WAIT_MS * (G_USEC_PER_SEC / 1000);
+
+    do {
+        GBinderRemoteObject* remote =
+            gbinder_servicemanager_get_service_sync(sm, fqname, NULL);
+
+        if (remote) {
+            return remote;
+        }
+        g_usleep(SERVICE_POLL_MS * (G_USEC_PER_SEC / 1000));
+    } while (g_get_monotonic_time() < deadline);
+    return NULL;
+}
+
+static
+int
+binder_nfc_bench_hal_run_backend(
+    const BinderNfcBenchHalBackend* backend,
+    const BinderNfcBenchHalOpt* opt,
+    const char* fqname)
+{
+    int ret = RET_ERR;
+    GBinderServiceManager* sm = gbinder_servicemanager_new(backend->dev);
+    GBinderRemoteObject* remote = sm ?
+        binder_nfc_bench_hal_wait_service(sm, fqname) : NULL;
+
+    if (remote) {
+        BinderNfcBenchHal bench;
+        guint i;
+
+        memset(&bench, 0, sizeof(bench));
+        bench.opt = opt;
+        bench.ret = RET_OK;
+        bench.loop = g_main_loop_new(NULL, FALSE);
+        bench.api = backend->api(remote);
+        bench.samples = g_new(gint64, opt->count);
+        bench.packet_size = 3 + opt->size;
+        bench.packet = g_malloc(bench.packet_size);
+
+        /* NCI data packet header followed by the payload */
+        bench.packet[0] = 0x00;
+        bench.packet[1] = 0x00;
+        bench.packet[2] = (guint8) opt->size;
+        for (i = 3; i < bench.packet_size; i++) {
+            bench.packet[i] = (guint8) i;
+        }
+
+        bench.data_id = binder_nfc_api_add_data_handler(bench.api,
+            binder_nfc_bench_hal_data, &bench);
+        if (binder_nfc_api_open(bench.api, binder_nfc_bench_hal_open_complete,
+            NULL, &bench)) {
+            g_main_loop_run(bench.loop);
+        } else {
+            binder_nfc_bench_hal_fail(&bench, "open");
+        }
+
+        if (bench.ret == RET_OK) {
+            char* title = g_strdup_printf("%s (%u byte packets)",
+                backend->name, (guint) bench.packet_size);
+
+            binder_nfc_bench_report(title, bench.samples, opt->count,
+                bench.end - bench.start);
+            g_free(title);
+        }
+        ret = bench.ret;
+
+        binder_nfc_api_remove_handler(bench.api, bench.data_id);
+        g_object_unref(bench.api);
+        g_main_loop_unref(bench.loop);
+        g_free(bench.samples);
+        g_free(bench.packet);
+    } else {
+        GERR("%s not found", fqname);
+    }
+    gbinder_servicemanager_unref(sm);
+    return ret;
+}
+
+static
+int
+binder_nfc_bench_hal_run(
+    int argc,
+    char* argv[])
+{
+    int ret = RET_CMDLINE;
+    char* backend_name = NULL;
+    char* instance = NULL;
+    BinderNfcBenchHalOpt opt;
+    GOptionContext* options;
+    GError* error = NULL;
+    GOptionEntry entries[] = {
+        { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend_name,
+          "Backend to test (hidl or aidl, default both)", "NAME" },
+        { "instance", 'i', 0, G_OPTION_ARG_STRING, &instance,
+          "Fake service instance [" DEFAULT_INSTANCE "]", "NAME" },
+        { "count", 'n', 0, G_OPTION_ARG_INT, &opt.count,
+          "Number of round trips to measure [" G_STRINGIFY(DEFAULT_COUNT)
+          "]", "N" },
+        { "warmup", 'w', 0, G_OPTION_ARG_INT, &opt.warmup,
+          "Number of round trips to skip [" G_STRINGIFY(DEFAULT_WARMUP)
+          "]", "N" },
+        { "size", 's', 0, G_OPTION_ARG_INT, &opt.size,
+          "Packet payload size, 0..255 [" G_STRINGIFY(DEFAULT_SIZE) "]",
+          "BYTES" },
+        { NULL }
+    };
+
+    memset(&opt, 0, sizeof(opt));
+    opt.instance = DEFAULT_INSTANCE;
+    opt.count = DEFAULT_COUNT;
+    opt.warmup = DEFAULT_WARMUP;
+    opt.size = DEFAULT_SIZE;
+
+    options = g_option_context_new("- measure binder NFC HAL round trips");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error) && argc == 1 &&
+        opt.count > 0 && opt.warmup >= 0 && opt.size >= 0 &&
+        opt.size <= 255) {
+        const BinderNfcBenchHalBackend* backends[N_BACKENDS];
+        char* fqnames[N_BACKENDS];
+        pid_t pids[N_BACKENDS];
+        guint i, n = 0;
+
+        if (instance) {
+            opt.instance = instance;
+        }
+
+        for (i = 0; i < N_BACKENDS; i++) {
+            const BinderNfcBenchHalBackend* backend =
+                binder_nfc_bench_hal_backends + i;
+
+            if (!backend_name || !strcmp(backend_name, backend->name)) {
+                backends[n++] = backend;
+            }
+        }
+
+        if (n) {
+            /*
+             * Fork all the services before touching binder in the parent,
+             * libgbinder threads don't survive fork().
+             */
+            for (i = 0; i < n; i++) {
+                fqnames[i] = g_strconcat(backends[i]->iface, "/",
+                    opt.instance, NULL);
+                pids[i] = fork();
+                if (!pids[i]) {
+                    _exit(binder_nfc_bench_hal_service_run(backends[i],
+                        fqnames[i]));
+                }
+            }
+
+            ret = RET_OK;
+            for (i = 0; i < n; i++) {
+                if (pids[i] > 0) {
+                    if (binder_nfc_bench_hal_run_backend(backends[i], &opt,
+                        fqnames[i]) != RET_OK) {
+                        ret = RET_ERR;
+                    }
+                    kill(pids[i], SIGTERM);
+                    waitpid(pids[i], NULL, 0);
+                } else {
+                    GERR("Failed to start %s service", backends[i]->name);
+                    ret = RET_ERR;
+                }
+                g_free(fqnames[i]);
+            }
+        } else {
+            GERR("Unknown backend %s", backend_name);
+        }
+    } else if (error) {
+        GERR("%s", error->message);
+        g_error_free(error);
+    } else {
+        char* help = g_option_context_get_help(options, TRUE, NULL);
+
+        fprintf(stderr, "%s", help);
+        g_free(help);
+    }
+    g_option_context_free(options);
+    g_free(backend_name);
+    g_free(instance);
+    return ret;
+}
+
+const BinderNfcBenchCmd binder_nfc_bench_hal = {
+    "hal",
+    "Round trip through a loopback fake NFC HAL",
+    binder_nfc_bench_hal_run
+};
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,310 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "bench.h"
+#include "binder_nfc_sched.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Wakeup-to-dispatch latency under CPU load. The main thread posts
+ * callbacks to a thread running a main loop, the same way libgbinder
+ * hands HAL callbacks over to nfcd's main thread, and measures how long
+ * each one takes to get dispatched while a number of other threads are
+ * burning CPU. That is done twice, with the default scheduling and with
+ * the scheduling specified on the command line (which is what the
+ * RealtimePriority, Nice and CpuAffinity options do to nfcd's main
+ * thread).
+ */
+
+#define DEFAULT_COUNT       5000
+#define DEFAULT_INTERVAL    1000
+
+typedef struct binder_nfc_bench_sched_opt {
+    int count;
+    int load;
+    int interval_us;
+    BinderNfcSched sched;
+} BinderNfcBenchSchedOpt;
+
+typedef struct binder_nfc_bench_sched_run {
+    const BinderNfcSched* sched;
+    GMainContext* context;
+    GMainLoop* loop;
+    gint64* samples;
+    guint count;
+    guint done;
+} BinderNfcBenchSchedRun;
+
+typedef struct binder_nfc_bench_sched_event {
+    BinderNfcBenchSchedRun* run;
+    guint index;
+    gint64 posted;
+} BinderNfcBenchSchedEvent;
+
+/*==========================================================================*
+ * Threads
+ *==========================================================================*/
+
+static
+gpointer
+binder_nfc_bench_sched_load_thread(
+    gpointer stop)
+{
+    volatile guint64 spins = 0;
+
+    while (!g_atomic_int_get((gint*)stop)) {
+        spins++;
+    }
+    return NULL;
+}
+
+static
+gpointer
+binder_nfc_bench_sched_dispatch_thread(
+    gpointer data)
+{
+    BinderNfcBenchSchedRun* run = data;
+    BinderNfcSchedSaved* saved = NULL;
+
+    g_main_context_push_thread_default(run->context);
+    if (run->sched) {
+        saved = binder_nfc_sched_apply(run->sched);
+    }
+    g_main_loop_run(run->loop);
+    binder_nfc_sched_restore(saved);
+    g_main_context_pop_thread_default(run->context);
+    return NULL;
+}
+
+/*==========================================================================*
+ * Measurement
+ *==========================================================================*/
+
+static
+gboolean
+binder_nfc_bench_sched_event_proc(
+    gpointer data)
+{
+    BinderNfcBenchSchedEvent* event = data;
+    BinderNfcBenchSchedRun* run = event->run;
+
+    run->samples[event->index] = g_get_monotonic_time() - event->posted;
+    if (++run->done == run->count) {
+        g_main_loop_quit(run->loop);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_bench_sched_measure(
+    const char* title,
+    const BinderNfcBenchSchedOpt* opt,
+    const BinderNfcSched* sched)
+{
+    BinderNfcBenchSchedRun run;
+    GThread* thread;
+    gint64 start;
+    guint i;
+
+    memset(&run, 0, sizeof(run));
+    run.sched = sched;
+    run.context = g_main_context_new();
+    run.loop = g_main_loop_new(run.context, FALSE);
+    run.samples = g_new0(gint64, opt->count);
+    run.count = opt->count;
+
+    thread = g_thread_new(title, binder_nfc_bench_sched_dispatch_thread,
+        &run);
+    while (!g_main_loop_is_running(run.loop)) {
+        g_usleep(1000);
+    }
+
+    start = g_get_monotonic_time();
+    for (i = 0; i < run.count; i++) {
+        BinderNfcBenchSchedEvent* event = g_new(BinderNfcBenchSchedEvent, 1);
+        GSource* source = g_idle_source_new();
+
+        g_usleep(opt->interval_us);
+        event->run = &run;
+        event->index = i;
+        g_source_set_priority(source, G_PRIORITY_DEFAULT);
+        g_source_set_callback(source, binder_nfc_bench_sched_event_proc,
+            event, g_free);
+        event->posted = g_get_monotonic_time();
+        g_source_attach(source, run.context);
+        g_source_unref(source);
+    }
+    g_thread_join(thread);
+
+    binder_nfc_bench_report(title, run.samples, run.count,
+        g_get_monotonic_time() - start);
+    g_free(run.samples);
+    g_main_loop_unref(run.loop);
+    g_main_context_unref(run.context);
+}
+
+static
+int
+binder_nfc_bench_sched_test(
+    const BinderNfcBenchSchedOpt* opt)
+{
+    GThread** load = g_new0(GThread*, opt->load);
+    gint stop = 0;
+    int i;
+
+    printf("%d load thread(s), %d samples %d us apart\n", opt->load,
+        opt->count, opt->interval_us);
+    for (i = 0; i < opt->load; i++) {
+        load[i] = g_thread_new("load", binder_nfc_bench_sched_load_thread,
+            &stop);
+    }
+
+    binder_nfc_bench_sched_measure("default", opt, NULL);
+    if (opt->sched.rt_priority || opt->sched.nice || opt->sched.cpu_mask) {
+        binder_nfc_bench_sched_measure("tuned", opt, &opt->sched);
+    }
+
+    g_atomic_int_set(&stop, 1);
+    for (i = 0; i < opt->load; i++) {
+        g_thread_join(load[i]);
+    }
+    g_free(load);
+    return RET_OK;
+}
+
+static
+gboolean
+binder_nfc_bench_sched_parse_cpus(
+    const char* spec,
+    guint64* mask)
+{
+    char** cpus = g_strsplit_set(spec, ",;", -1);
+    char** ptr;
+    gboolean ok = TRUE;
+
+    *mask = 0;
+    for (ptr = cpus; *ptr && ok; ptr++) {
+        const char* str = g_strstrip(*ptr);
+        char* end = NULL;
+        const guint64 cpu = g_ascii_strtoull(str, &end, 10);
+
+        if (end && end != str && !*end && cpu < BINDER_NFC_SCHED_MAX_CPUS) {
+            *mask |= (G_GUINT64_CONSTANT(1) << cpu);
+        } else {
+            GERR("Invalid CPU \"%s\"", str);
+            ok = FALSE;
+        }
+    }
+    g_strfreev(cpus);
+    return ok && *mask;
+}
+
+static
+int
+binder_nfc_bench_sched_run(
+    int argc,
+    char* argv[])
+{
+    int ret = RET_CMDLINE;
+    BinderNfcBenchSchedOpt opt;
+    GOptionContext* options;
+    GError* error = NULL;
+    char* cpus = NULL;
+    GOptionEntry entries[] = {
+        { "count", 'n', 0, G_OPTION_ARG_INT, &opt.count,
+          "Number of wakeups [" G_STRINGIFY(DEFAULT_COUNT) "]", "N" },
+        { "load", 'l', 0, G_OPTION_ARG_INT, &opt.load,
+          "Number of CPU burning threads [number of CPUs]", "N" },
+        { "interval", 'i', 0, G_OPTION_ARG_INT, &opt.interval_us,
+          "Microseconds between wakeups [" G_STRINGIFY(DEFAULT_INTERVAL)
+          "]", "US" },
+        { "priority", 'p', 0, G_OPTION_ARG_INT, &opt.sched.rt_priority,
+          "SCHED_FIFO priority (1..99)", "N" },
+        { "nice", 'N', 0, G_OPTION_ARG_INT, &opt.sched.nice,
+          "Nice value (-20..19)", "N" },
+        { "cpus", 'c', 0, G_OPTION_ARG_STRING, &cpus,
+          "CPU affinity, e.g. 4,5", "LIST" },
+        { NULL }
+    };
+
+    memset(&opt, 0, sizeof(opt));
+    opt.count = DEFAULT_COUNT;
+    opt.load = g_get_num_processors();
+    opt.interval_us = DEFAULT_INTERVAL;
+
+    options = g_option_context_new("- wakeup latency under CPU load");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error) && argc == 1 &&
+        opt.count > 0 && opt.load >= 0 && opt.interval_us >= 0 &&
+        opt.sched.rt_priority >= 0 &&
+        opt.sched.rt_priority <= BINDER_NFC_SCHED_MAX_RT_PRIORITY &&
+        opt.sched.nice >= BINDER_NFC_SCHED_MIN_NICE &&
+        opt.sched.nice <= BINDER_NFC_SCHED_MAX_NICE &&
+        (!cpus || binder_nfc_bench_sched_parse_cpus(cpus,
+        &opt.sched.cpu_mask))) {
+        ret = binder_nfc_bench_sched_test(&opt);
+    } else if (error) {
+        GERR("%s", error->message);
+        g_error_free(error);
+    } else {
+        char* help = g_option_context_get_help(options, TRUE, NULL);
+
+        fprintf(stderr, "%s", help);
+        g_free(help);
+    }
+    g_option_context_free(options);
+    g_free(cpus);
+    return ret;
+}
+
+const BinderNfcBenchCmd binder_nfc_bench_sched = {
+    "sched",
+    "Wakeup-to-dispatch latency under CPU load",
+    binder_nfc_bench_sched_run
+};
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
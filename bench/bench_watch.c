@@ -0,0 +1,477 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "bench.h"
+#include "binder_nfc_api_aidl.h"
+#include "binder_nfc_api_hidl.h"
+#include "binder_nfc_watcher.h"
+
+#include <gbinder.h>
+
+#include <glib-unix.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Service discovery during boot, as done by BinderNfcWatcher. The parent
+ * creates a watcher and tells the child process to go. The child then
+ * registers lots of dummy services back to back, followed by a fake NFC
+ * service. The service manager only notifies the watcher about the names
+ * it's watching, the same way it does it for the plugin. What's measured
+ * is how soon the watcher reports the NFC service after it has been
+ * registered, and how many notifications and service list fetches it
+ * took to get there.
+ */
+
+#define DEFAULT_INSTANCE    "bench"
+#define DEFAULT_SERVICES    500
+#define FOUND_WAIT_MS       30000
+
+typedef struct binder_nfc_bench_watch_backend {
+    const char* name;
+    const char* dev;
+    const char* iface;
+    const char* dummy_iface;
+    gboolean watch_instance; /* Notifications are only sent for full names */
+    BinderNfcApi* (*api)(GBinderRemoteObject* remote);
+} BinderNfcBenchWatchBackend;
+
+typedef struct binder_nfc_bench_watch_opt {
+    const char* instance;
+    int services;
+} BinderNfcBenchWatchOpt;
+
+typedef struct binder_nfc_bench_watch_child {
+    const BinderNfcBenchWatchBackend* backend;
+    char* fqname;
+    pid_t pid;
+    int go_fd;      /* Written by the parent to start registrations */
+    int done_fd;    /* Read by the parent, when NFC has been registered */
+} BinderNfcBenchWatchChild;
+
+typedef struct binder_nfc_bench_watch {
+    GMainLoop* loop;
+    const char* fqname;
+    gboolean child_done;
+    gint64 registered;
+    gint64 found;
+} BinderNfcBenchWatch;
+
+static const BinderNfcBenchWatchBackend binder_nfc_bench_watch_backends[] = {
+    {
+        "hidl",
+        GBINDER_DEFAULT_HWBINDER,
+        BINDER_NFC_HIDL_IFACE,
+        "vendor.bench.hardware.dummy@1.0::IDummy",
+        FALSE,
+        binder_nfc_api_hidl_new
+    },{
+        "aidl",
+        GBINDER_DEFAULT_BINDER,
+        BINDER_NFC_AIDL_IFACE,
+        "vendor.bench.hardware.dummy.IDummy",
+        TRUE,
+        binder_nfc_api_aidl_new
+    }
+};
+
+#define N_BACKENDS G_N_ELEMENTS(binder_nfc_bench_watch_backends)
+
+/*==========================================================================*
+ * Fake services (run in the child process)
+ *==========================================================================*/
+
+static
+GBinderLocalReply*
+binder_nfc_bench_watch_service_handler(
+    GBinderLocalObject* obj,
+    GBinderRemoteRequest* req,
+    guint code,
+    guint flags,
+    int* status,
+    void* user_data)
+{
+    /* Nobody is supposed to call these */
+    *status = GBINDER_STATUS_FAILED;
+    return NULL;
+}
+
+static
+gboolean
+binder_nfc_bench_watch_service_quit(
+    gpointer loop)
+{
+    g_main_loop_quit(loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+int
+binder_nfc_bench_watch_service_run(
+    const BinderNfcBenchWatchBackend* backend,
+    const BinderNfcBenchWatchOpt* opt,
+    const char* fqname,
+    int go_fd,
+    int done_fd)
+{
+    int ret = RET_ERR;
+    gint64 registered = 0;
+    GBinderServiceManager* sm;
+    char go;
+
+    /* Don't start until the parent is watching */
+    if (read(go_fd, &go, 1) != 1) {
+        return ret;
+    }
+
+    sm = gbinder_servicemanager_new(backend->dev);
+    if (sm) {
+        GBinderLocalObject* dummy = gbinder_servicemanager_new_local_object
+            (sm, backend->dummy_iface, binder_nfc_bench_watch_service_handler,
+                NULL);
+        GBinderLocalObject* nfc = gbinder_servicemanager_new_local_object
+            (sm, backend->iface, binder_nfc_bench_watch_service_handler,
+                NULL);
+        int i;
+
+        ret = RET_OK;
+        for (i = 0; i < opt->services && ret == RET_OK; i++) {
+            char* name = g_strdup_printf("%s/%s%d", backend->dummy_iface,
+                opt->instance, i);
+
+            if (gbinder_servicemanager_add_service_sync(sm, name, dummy) !=
+                GBINDER_STATUS_OK) {
+                GERR("Failed to register %s", name);
+                ret = RET_ERR;
+            }
+            g_free(name);
+        }
+        if (ret == RET_OK) {
+            const gint64 now = g_get_monotonic_time();
+
+            if (gbinder_servicemanager_add_service_sync(sm, fqname, nfc) ==
+                GBINDER_STATUS_OK) {
+                registered = now;
+                GDEBUG("Registered %s", fqname);
+            } else {
+                GERR("Failed to register %s", fqname);
+                ret = RET_ERR;
+            }
+        }
+
+        /* Zero means that the NFC service hasn't been registered */
+        if (write(done_fd, &registered, sizeof(registered)) ==
+            sizeof(registered) && registered) {
+            GMainLoop* loop = g_main_loop_new(NULL, FALSE);
+            guint sigterm = g_unix_signal_add(SIGTERM,
+                binder_nfc_bench_watch_service_quit, loop);
+
+            /* Keep the services registered until the parent is done */
+            g_main_loop_run(loop);
+            g_source_remove(sigterm);
+            g_main_loop_unref(loop);
+        }
+        gbinder_local_object_unref(dummy);
+        gbinder_local_object_unref(nfc);
+        gbinder_servicemanager_unref(sm);
+    }
+    return ret;
+}
+
+/*==========================================================================*
+ * Watching side
+ *==========================================================================*/
+
+static
+void
+binder_nfc_bench_watch_found(
+    BinderNfcWatcher* watcher,
+    GBinderRemoteObject* remote,
+    const char* fqname,
+    gpointer user_data)
+{
+    BinderNfcBenchWatch* bench = user_data;
+
+    /* There may be a real NFC HAL too */
+    if (!bench->found && !strcmp(fqname, bench->fqname)) {
+        bench->found = g_get_monotonic_time();
+        if (bench->child_done) {
+            g_main_loop_quit(bench->loop);
+        }
+    }
+}
+
+static
+gboolean
+binder_nfc_bench_watch_child_done(
+    gint fd,
+    GIOCondition condition,
+    gpointer user_data)
+{
+    BinderNfcBenchWatch* bench = user_data;
+
+    if (read(fd, &bench->registered, sizeof(bench->registered)) !=
+        sizeof(bench->registered)) {
+        bench->registered = 0;
+    }
+    bench->child_done = TRUE;
+    if (bench->found || !bench->registered) {
+        g_main_loop_quit(bench->loop);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+binder_nfc_bench_watch_timeout(
+    gpointer user_data)
+{
+    BinderNfcBenchWatch* bench = user_data;
+
+    g_main_loop_quit(bench->loop);
+    return G_SOURCE_CONTINUE;
+}
+
+static
+int
+binder_nfc_bench_watch_run_backend(
+    BinderNfcBenchWatchChild* child,
+    const BinderNfcBenchWatchOpt* opt)
+{
+    const BinderNfcBenchWatchBackend* backend = child->backend;
+    int ret = RET_ERR;
+    BinderNfcBenchWatch bench;
+    BinderNfcBackend watch;
+    BinderNfcWatcher* watcher;
+
+    /* Same thing as the plugin's backend, but watching our instance */
+    memset(&watch, 0, sizeof(watch));
+    watch.name = backend->name;
+    watch.dev = backend->dev;
+    watch.watch = backend->watch_instance ? child->fqname : backend->iface;
+    watch.api = backend->api;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.fqname = child->fqname;
+    bench.loop = g_main_loop_new(NULL, FALSE);
+    watcher = binder_nfc_watcher_new(&watch);
+    if (watcher) {
+        const gulong id = binder_nfc_watcher_add_handler(watcher,
+            binder_nfc_bench_watch_found, &bench);
+        const guint done_id = g_unix_fd_add(child->done_fd, G_IO_IN |
+            G_IO_HUP | G_IO_ERR, binder_nfc_bench_watch_child_done, &bench);
+        const guint timeout_id = g_timeout_add(FOUND_WAIT_MS,
+            binder_nfc_bench_watch_timeout, &bench);
+        const gint64 start = g_get_monotonic_time();
+
+        if (write(child->go_fd, "g", 1) == 1) {
+            g_main_loop_run(bench.loop);
+        }
+        if (bench.found && bench.registered) {
+            printf("%s: %d dummy registration(s) in %" G_GINT64_FORMAT
+                " us, NFC found %" G_GINT64_FORMAT " us after registering it, "
+                "%u notification(s), %u list call(s)\n", backend->name,
+                opt->services, bench.registered - start,
+                bench.found - bench.registered, watcher->notifications,
+                watcher->list_calls);
+            ret = RET_OK;
+        } else {
+            GERR("%s not found", child->fqname);
+        }
+        if (!bench.child_done) {
+            g_source_remove(done_id);
+        }
+        g_source_remove(timeout_id);
+        g_signal_handler_disconnect(watcher, id);
+        g_object_unref(watcher);
+    }
+    g_main_loop_unref(bench.loop);
+    return ret;
+}
+
+static
+gboolean
+binder_nfc_bench_watch_fork(
+    BinderNfcBenchWatchChild* child,
+    const BinderNfcBenchWatchOpt* opt)
+{
+    int go[2], done[2];
+
+    if (pipe(go) == 0) {
+        if (pipe(done) == 0) {
+            child->pid = fork();
+            if (!child->pid) {
+                close(go[1]);
+                close(done[0]);
+                _exit(binder_nfc_bench_watch_service_run(child->backend, opt,
+                    child->fqname, go[0], done[1]));
+            }
+            close(go[0]);
+            close(done[1]);
+            if (child->pid > 0) {
+                child->go_fd = go[1];
+                child->done_fd = done[0];
+                return TRUE;
+            }
+            close(go[1]);
+            close(done[0]);
+        } else {
+            close(go[0]);
+            close(go[1]);
+        }
+    }
+    return FALSE;
+}
+
+static
+int
+binder_nfc_bench_watch_run(
+    int argc,
+    char* argv[])
+{
+    int ret = RET_CMDLINE;
+    char* backend_name = NULL;
+    char* instance = NULL;
+    BinderNfcBenchWatchOpt opt;
+    GOptionContext* options;
+    GError* error = NULL;
+    GOptionEntry entries[] = {
+        { "backend", 'b', 0, G_OPTION_ARG_STRING, &backend_name,
+          "Backend to test (hidl or aidl, default both)", "NAME" },
+        { "instance", 'i', 0, G_OPTION_ARG_STRING, &instance,
+          "Fake service instance [" DEFAULT_INSTANCE "]", "NAME" },
+        { "services", 'n', 0, G_OPTION_ARG_INT, &opt.services,
+          "Number of dummy services to register first ["
+          G_STRINGIFY(DEFAULT_SERVICES) "]", "N" },
+        { NULL }
+    };
+
+    memset(&opt, 0, sizeof(opt));
+    opt.instance = DEFAULT_INSTANCE;
+    opt.services = DEFAULT_SERVICES;
+
+    options = g_option_context_new("- measure NFC service discovery");
+    g_option_context_add_main_entries(options, entries, NULL);
+    if (g_option_context_parse(options, &argc, &argv, &error) && argc == 1 &&
+        opt.services >= 0) {
+        BinderNfcBenchWatchChild children[N_BACKENDS];
+        gboolean forked[N_BACKENDS];
+        guint i, n = 0;
+
+        if (instance) {
+            opt.instance = instance;
+        }
+
+        memset(children, 0, sizeof(children));
+        for (i = 0; i < N_BACKENDS; i++) {
+            const BinderNfcBenchWatchBackend* backend =
+                binder_nfc_bench_watch_backends + i;
+
+            if (!backend_name || !strcmp(backend_name, backend->name)) {
+                children[n++].backend = backend;
+            }
+        }
+
+        if (n) {
+            /*
+             * Fork all the services before touching binder in the parent,
+             * libgbinder threads don't survive fork(). Each child waits
+             * for the parent to start watching.
+             */
+            for (i = 0; i < n; i++) {
+                BinderNfcBenchWatchChild* child = children + i;
+
+                child->fqname = g_strconcat(child->backend->iface, "/",
+                    opt.instance, NULL);
+                forked[i] = binder_nfc_bench_watch_fork(child, &opt);
+            }
+
+            ret = RET_OK;
+            for (i = 0; i < n; i++) {
+                BinderNfcBenchWatchChild* child = children + i;
+
+                if (forked[i]) {
+                    if (binder_nfc_bench_watch_run_backend(child, &opt) !=
+                        RET_OK) {
+                        ret = RET_ERR;
+                    }
+                    close(child->go_fd);
+                    close(child->done_fd);
+                    kill(child->pid, SIGTERM);
+                    waitpid(child->pid, NULL, 0);
+                } else {
+                    GERR("Failed to start %s services", child->backend->name);
+                    ret = RET_ERR;
+                }
+                g_free(child->fqname);
+            }
+        } else {
+            GERR("Unknown backend %s", backend_name);
+        }
+    } else if (error) {
+        GERR("%s", error->message);
+        g_error_free(error);
+    } else {
+        char* help = g_option_context_get_help(options, TRUE, NULL);
+
+        fprintf(stderr, "%s", help);
+        g_free(help);
+    }
+    g_option_context_free(options);
+    g_free(backend_name);
+    g_free(instance);
+    return ret;
+}
+
+const BinderNfcBenchCmd binder_nfc_bench_watch = {
+    "watch",
+    "Service discovery by BinderNfcWatcher",
+    binder_nfc_bench_watch_run
+};
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
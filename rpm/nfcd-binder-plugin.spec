@@ -15,6 +15,7 @@ BuildRequires: pkgconfig(libncicore)
 BuildRequires: pkgconfig(libnciplugin)
 BuildRequires: pkgconfig(libgbinder) >= %{libgbinder_version}
 BuildRequires: pkgconfig(nfcd-plugin) >= %{nfcd_version}
+%{?enable_usdt:BuildRequires: systemtap-sdt-devel}
 
 # license macro requires rpm >= 4.11
 BuildRequires: pkgconfig(rpm)
@@ -35,7 +36,7 @@ Binder-based NCI I/O plugin for nfcd
 %setup -q
 
 %build
-%make_build %{?disable_hexdump: DISABLE_HEXDUMP=1} KEEP_SYMBOLS=1 release
+%make_build %{?disable_hexdump: DISABLE_HEXDUMP=1} %{?enable_usdt: ENABLE_USDT=1} KEEP_SYMBOLS=1 release
 
 %install
 make DESTDIR=%{buildroot} PLUGIN_DIR=%{plugin_dir} install
@@ -39,6 +39,12 @@
 
 #include "binder_nfc_adapter.h"
 #include "binder_nfc_api.h"
+#include "binder_nfc_config.h"
+#include "binder_nfc_framer.h"
+#include "binder_nfc_recorder.h"
+#include "binder_nfc_stats.h"
+#include "binder_nfc_timeline.h"
+#include "binder_nfc_trace.h"
 
 #include <nci_adapter_impl.h>
 
@@ -50,6 +56,8 @@
 #include <gutil_misc.h>
 #include <gutil_macros.h>
 
+#include <string.h>
+
 /* binder_hexdump_log is a sub-module, just to turn prefix off */
 GLogModule binder_hexdump_log = {
     .name = "binder-hexdump",
@@ -60,6 +68,7 @@ GLogModule binder_hexdump_log = {
 };
 
 typedef struct binder_nfc_adapter BinderNfcAdapter;
+typedef struct binder_nci_write_data BinderNciWriteData;
 typedef NciAdapterClass BinderNfcAdapterClass;
 
 typedef
@@ -67,23 +76,98 @@ void
 (*BinderNfcAdapterFunc)(
     BinderNfcAdapter* self);
 
+/* Inbound packets collected during one main loop iteration */
+#define BINDER_NFC_READ_BATCH_BUF (4096)
+#define BINDER_NFC_READ_BATCH_MAX (32)
+
+typedef struct binder_nfc_read_batch {
+    guint flush_id;
+    guint count;
+    gsize len;
+    guint16 size[BINDER_NFC_READ_BATCH_MAX];
+    guint8 buf[BINDER_NFC_READ_BATCH_BUF];
+} BinderNfcReadBatch;
+
+/* Packets received while the NCI core isn't listening */
+#define BINDER_NFC_EARLY_READ_MAX (8)
+
+typedef struct binder_nfc_early_read {
+    guint len;
+    guint8 data[BINDER_NFC_NCI_PACKET_MAX];
+} BinderNfcEarlyRead;
+
 struct binder_nfc_adapter {
     NciAdapter adapter;
     BinderNfcApi* api;
     NciHalIo hal_io;
     NciHalClient* hal_client;
-    gulong nci_write_id;
+    BinderNciWriteData* write_head;
+    BinderNciWriteData* write_tail;
+    BinderNciWriteData* write_pool;
+    guint write_count;
+    guint write_queue_max;
+    guint write_ack_id;
+    guint write_pool_allocated;
     gulong death_id;
     gulong event_id;
     gulong data_id;
+    gboolean batch_reads;
+    gboolean reassemble;
+    guint read_batches;
+    guint read_batched;
+    BinderNfcReadBatch read_batch;
+    BinderNfcFramer framer;
+    guint early_read_first;
+    guint early_read_count;
+    guint early_read_id;
+    guint early_replayed;
+    guint early_dropped;
+    BinderNfcEarlyRead early_read[BINDER_NFC_EARLY_READ_MAX];
 
     gboolean core_initialized;
     gboolean need_power;
     gboolean power_on;
     gboolean power_switch_pending;
     gulong pending_tx;
+    gulong core_initialized_tx;
+    gulong prediscover_tx;
+    guint close_delay_ms;
+    gboolean host_switched_off;
+    gboolean host_switched_off_broken;
+    gboolean switched_off;
+    guint switched_off_resumes;
+    BINDER_NFC_CLOSE_TYPE close_type;
+    guint close_timer_id;
+    guint warm_notify_id;
+    guint warm_resumes;
+    gboolean recovery_pending;
+    gint64 recovery_start;
+    guint recovery_failures;
+    guint power_cycles;
+    guint nci_errors;
+    gboolean power_cycle_broken;
+    gboolean power_cycle_skip;
+    BinderNfcHistogram recovery_time;
+    gboolean keep_callback;
+    gboolean disconnected;
+    gint64 death_time;
+    guint call_timeout_ms;
+    guint write_timeout_ms;
+    guint loop_probe_ms;
+    guint loop_probe_id;
+    gint64 loop_probe_due;
+    BinderNfcHistogram loop_lag;
+    guint call_timer_id;
+    guint write_timer_id;
+    gulong watched_tx;
+    BinderNfcApiCompleteFunc watched_tx_complete;
+    guint call_timeouts;
+    guint event_timeouts;
+    guint write_timeouts;
     BinderNfcAdapterFunc open_cplt;
     BinderNfcAdapterFunc close_cplt;
+    BinderNfcTimeline timeline;
+    BinderNfcRecorder recorder;
 };
 
 #define PARENT_CLASS binder_nfc_adapter_parent_class
@@ -101,6 +185,12 @@ enum binder_nfc_adapter_signal {
 
 #define SIGNAL_DEATH_NAME "binder-nfc-adapter-death"
 
+/* Consecutive NCI errors to recover from */
+#define BINDER_NFC_MAX_NCI_ERRORS (3)
+
+/* How often to retry a deferred close that had to wait */
+#define BINDER_NFC_CLOSE_RETRY_MS (100)
+
 static guint binder_nfc_adapter_signals[SIGNAL_COUNT] = { 0 };
 
 static
@@ -113,6 +203,43 @@ void
 binder_nfc_adapter_state_check(
     BinderNfcAdapter* self);
 
+static
+void
+binder_nfc_adapter_recover(
+    BinderNfcAdapter* self,
+    const char* reason);
+
+static
+void
+binder_nfc_adapter_watch_tx(
+    BinderNfcAdapter* self,
+    BinderNfcApiCompleteFunc complete);
+
+static
+void
+binder_nfc_adapter_watch_event(
+    BinderNfcAdapter* self);
+
+static
+void
+binder_nfc_adapter_post_init_cplt(
+    BinderNfcAdapter* self);
+
+static
+void
+binder_nfc_adapter_pre_discover_cplt(
+    BinderNfcAdapter* self);
+
+static
+void
+binder_nfc_adapter_write_cancel_all(
+    BinderNfcAdapter* self);
+
+static
+void
+binder_nfc_adapter_loop_probe_check(
+    BinderNfcAdapter* self);
+
 /*==========================================================================*
  *  Trace
  *==========================================================================*/
@@ -158,14 +285,267 @@ binder_dump_data(
     }
 }
 
+static
+void
+binder_dump_chunks(
+    char dir,
+    const GUtilData* chunks,
+    guint count)
+{
+    const int level = GLOG_LEVEL_VERBOSE;
+    GLogModule* log = &binder_hexdump_log;
+
+    if (gutil_log_enabled(log, level)) {
+        guint i;
+
+        for (i = 0; i < count; i++) {
+            binder_hexdump(log, level, i ? ' ' : dir, chunks[i].bytes,
+                chunks[i].size);
+        }
+    }
+}
+
     #define BINDER_DUMP(dir, data, len)  binder_dump_data(dir, data, len)
+    #define BINDER_DUMP_CHUNKS(dir, chunks, count) \
+        binder_dump_chunks(dir, chunks, count)
     #define DUMP(f,args...)  gutil_log(&binder_hexdump_log, \
        GLOG_LEVEL_VERBOSE, f, ##args)
 #else
     #define BINDER_DUMP(dir, data, len)
+    #define BINDER_DUMP_CHUNKS(dir, chunks, count)
     #define DUMP(f,args...)
 #endif /* !DISABLE_HEXDUMP */
 
+static
+void
+binder_nfc_adapter_dump_recorder(
+    BinderNfcAdapter* self,
+    const char* reason)
+{
+    binder_nfc_recorder_dump(&self->recorder, NFC_ADAPTER(self)->name,
+        reason);
+}
+
+/*==========================================================================*
+ *  Inbound packets
+ *
+ * With BatchReads enabled, packets arriving back to back (e.g. the list
+ * of RF_DISCOVER_NTF or chained data segments) are copied to the batch
+ * buffer and delivered to the NCI core by a high priority idle callback,
+ * i.e. right after the main loop iteration during which they have
+ * arrived. The NCI core takes one packet per read() call, so that's
+ * still one call per packet. Anything which needs to happen after the
+ * packets which have already been received (HAL events, I/O errors)
+ * flushes the batch first.
+ *==========================================================================*/
+
+/*
+ * Packets arriving while there's no HAL client (e.g. CORE_RESET_NTF sent
+ * by the controller before the NCI core has started the I/O) are kept
+ * in a small buffer and replayed when the client shows up. If the buffer
+ * overflows, the oldest packets get dropped. Whatever was read for the
+ * previous client (when the I/O stops) or the previous session (when the
+ * HAL is opened again) is stale and is dropped too.
+ */
+
+static
+void
+binder_nfc_adapter_early_read_add(
+    BinderNfcAdapter* self,
+    const void* data,
+    gsize size)
+{
+    BinderNfcEarlyRead* early;
+
+    if (size > sizeof(early->data)) {
+        GWARN("Dropping %u byte(s) received too early", (guint) size);
+        self->early_dropped++;
+        return;
+    }
+    if (self->early_read_count == BINDER_NFC_EARLY_READ_MAX) {
+        GWARN("Too many packets received too early, dropping one");
+        self->early_read_first = (self->early_read_first + 1) %
+            BINDER_NFC_EARLY_READ_MAX;
+        self->early_read_count--;
+        self->early_dropped++;
+    }
+    early = self->early_read + ((self->early_read_first +
+        self->early_read_count) % BINDER_NFC_EARLY_READ_MAX);
+    early->len = (guint) size;
+    memcpy(early->data, data, size);
+    self->early_read_count++;
+    GDEBUG("%u packet(s) waiting for the NCI core", self->early_read_count);
+}
+
+static
+void
+binder_nfc_adapter_early_read_replay(
+    BinderNfcAdapter* self)
+{
+    if (self->early_read_id) {
+        g_source_remove(self->early_read_id);
+        self->early_read_id = 0;
+    }
+
+    /* The client may go away while we are at it */
+    while (self->early_read_count && self->hal_client) {
+        NciHalClient* hal_client = self->hal_client;
+        const BinderNfcEarlyRead* early = self->early_read +
+            self->early_read_first;
+
+        self->early_read_first = (self->early_read_first + 1) %
+            BINDER_NFC_EARLY_READ_MAX;
+        self->early_read_count--;
+        self->early_replayed++;
+        hal_client->fn->read(hal_client, early->data, early->len);
+    }
+}
+
+static
+void
+binder_nfc_adapter_early_read_clear(
+    BinderNfcAdapter* self)
+{
+    if (self->early_read_id) {
+        g_source_remove(self->early_read_id);
+        self->early_read_id = 0;
+    }
+    if (self->early_read_count) {
+        GDEBUG("Dropping %u stale packet(s)", self->early_read_count);
+        self->early_dropped += self->early_read_count;
+        self->early_read_count = 0;
+    }
+    self->early_read_first = 0;
+}
+
+static
+gboolean
+binder_nfc_adapter_early_read_proc(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+
+    self->early_read_id = 0;
+    binder_nfc_adapter_early_read_replay(self);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_adapter_read_deliver(
+    BinderNfcAdapter* self,
+    const void* data,
+    gsize size)
+{
+    NciHalClient* hal_client;
+
+    /* Early packets go first */
+    if (self->early_read_count && self->hal_client) {
+        binder_nfc_adapter_early_read_replay(self);
+    }
+    hal_client = self->hal_client;
+    if (hal_client) {
+        hal_client->fn->read(hal_client, data, size);
+    } else {
+        binder_nfc_adapter_early_read_add(self, data, size);
+    }
+}
+
+static
+void
+binder_nfc_adapter_read_flush(
+    BinderNfcAdapter* self)
+{
+    BinderNfcReadBatch* batch = &self->read_batch;
+
+    if (batch->flush_id) {
+        g_source_remove(batch->flush_id);
+        batch->flush_id = 0;
+    }
+    if (batch->count) {
+        const guint8* ptr = batch->buf;
+        const guint n = batch->count;
+        guint i;
+
+        /* Nothing gets added to the batch while it's being delivered */
+        batch->count = 0;
+        batch->len = 0;
+        self->read_batches++;
+        self->read_batched += n;
+        for (i = 0; i < n; i++) {
+            binder_nfc_adapter_read_deliver(self, ptr, batch->size[i]);
+            ptr += batch->size[i];
+        }
+    }
+}
+
+static
+void
+binder_nfc_adapter_read_discard(
+    BinderNfcAdapter* self)
+{
+    BinderNfcReadBatch* batch = &self->read_batch;
+
+    if (batch->flush_id) {
+        g_source_remove(batch->flush_id);
+        batch->flush_id = 0;
+    }
+    batch->count = 0;
+    batch->len = 0;
+}
+
+static
+gboolean
+binder_nfc_adapter_read_flush_proc(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+
+    self->read_batch.flush_id = 0;
+    binder_nfc_adapter_read_flush(self);
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_adapter_read(
+    BinderNfcAdapter* self,
+    const void* data,
+    gsize size)
+{
+    BinderNfcReadBatch* batch = &self->read_batch;
+
+    if (!self->batch_reads) {
+        binder_nfc_adapter_read_deliver(self, data, size);
+    } else if (size > sizeof(batch->buf)) {
+        /* Doesn't fit at all, keep the order though */
+        binder_nfc_adapter_read_flush(self);
+        binder_nfc_adapter_read_deliver(self, data, size);
+    } else {
+        if (batch->count == BINDER_NFC_READ_BATCH_MAX ||
+            batch->len + size > sizeof(batch->buf)) {
+            binder_nfc_adapter_read_flush(self);
+        }
+        memcpy(batch->buf + batch->len, data, size);
+        batch->size[batch->count++] = (guint16)size;
+        batch->len += size;
+        if (!batch->flush_id) {
+            batch->flush_id = g_idle_add_full(G_PRIORITY_HIGH,
+                binder_nfc_adapter_read_flush_proc, self, NULL);
+        }
+    }
+}
+
+static
+void
+binder_nfc_adapter_read_packet(
+    const void* packet,
+    gsize len,
+    void* user_data)
+{
+    binder_nfc_adapter_read(THIS(user_data), packet, len);
+}
+
 /*==========================================================================*
  *  Implementation
  *==========================================================================*/
@@ -180,15 +560,33 @@ binder_nfc_adapter_handle_event(
     BinderNfcAdapter* self = THIS(user_data);
     BinderNfcAdapterFunc action = NULL;
 
+    BINDER_TRACE1(event, event);
+    binder_nfc_adapter_read_flush(self);
     switch (event) {
     case BINDER_NFC_EVENT_OPEN_CPLT:
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_OPEN_CPLT);
         action = self->open_cplt;
         self->open_cplt = NULL;
         break;
     case BINDER_NFC_EVENT_CLOSE_CPLT:
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_CLOSE_CPLT);
         action = self->close_cplt;
         self->close_cplt = NULL;
         break;
+    case BINDER_NFC_EVENT_POST_INIT_CPLT:
+        action = binder_nfc_adapter_post_init_cplt;
+        break;
+    case BINDER_NFC_EVENT_PRE_DISCOVER_CPLT:
+        action = binder_nfc_adapter_pre_discover_cplt;
+        break;
+    case BINDER_NFC_EVENT_HCI_NETWORK_RESET:
+        binder_nfc_adapter_recover(self, "HCI network reset");
+        break;
+    case BINDER_NFC_EVENT_ERROR:
+        binder_nfc_adapter_recover(self, "HAL error");
+        break;
     default:
         break;
     }
@@ -207,12 +605,16 @@ binder_nfc_adapter_handle_data(
     gpointer user_data)
 {
     BinderNfcAdapter* self = THIS(user_data);
-    NciHalClient* hal_client = self->hal_client;
 
+    BINDER_TRACE1(read, size);
     DUMP("%c data, %u byte(s)", DIR_IN, (guint) size);
     BINDER_DUMP(DIR_IN, data, size);
-    if (hal_client) {
-        hal_client->fn->read(hal_client, data, size);
+    binder_nfc_recorder_add(&self->recorder, DIR_IN, data, size);
+    if (self->reassemble) {
+        binder_nfc_framer_input(&self->framer, data, size,
+            binder_nfc_adapter_read_packet, self);
+    } else {
+        binder_nfc_adapter_read(self, data, size);
     }
 }
 
@@ -224,20 +626,68 @@ binder_nfc_adapter_set_power(
 {
     NciCore* nci = self->adapter.nci;
 
+    BINDER_TRACE2(power, on, self->power_switch_pending);
     if (self->power_switch_pending) {
         self->power_switch_pending = FALSE;
         self->power_on = on;
         if (on) {
             nci_core_restart(nci);
         }
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_NOTIFY);
         nfc_adapter_power_notify(NFC_ADAPTER(self), on, TRUE);
     } else if (self->power_on != on) {
         self->power_on = on;
         if (on) {
             nci_core_restart(nci);
         }
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_NOTIFY);
         nfc_adapter_power_notify(NFC_ADAPTER(self), on, FALSE);
     }
+    binder_nfc_adapter_loop_probe_check(self);
+}
+
+/*
+ * Inbound packets are handed over to us by libgbinder through the
+ * default main context, i.e. they wait in line with everything else
+ * nfcd is doing. Since we can't take them out of that line, the least
+ * we can do is to measure how long the line is. The probe is a timer
+ * of the default priority, the amount of time it fires late is (more
+ * or less) the time a HAL callback would have spent waiting.
+ */
+
+static
+gboolean
+binder_nfc_adapter_loop_probe(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+    const gint64 now = g_get_monotonic_time();
+
+    binder_nfc_histogram_add(&self->loop_lag,
+        MAX(now - self->loop_probe_due, 0));
+    self->loop_probe_due = now + self->loop_probe_ms * 1000;
+    return G_SOURCE_CONTINUE;
+}
+
+static
+void
+binder_nfc_adapter_loop_probe_check(
+    BinderNfcAdapter* self)
+{
+    /* Only sample the main loop while NFC is on */
+    if (self->power_on && self->loop_probe_ms) {
+        if (!self->loop_probe_id) {
+            self->loop_probe_due = g_get_monotonic_time() +
+                self->loop_probe_ms * 1000;
+            self->loop_probe_id = g_timeout_add(self->loop_probe_ms,
+                binder_nfc_adapter_loop_probe, self);
+        }
+    } else if (self->loop_probe_id) {
+        g_source_remove(self->loop_probe_id);
+        self->loop_probe_id = 0;
+    }
 }
 
 static
@@ -255,6 +705,27 @@ void
 binder_nfc_adapter_open_done(
     BinderNfcAdapter* self)
 {
+    if (!self->need_power) {
+        /* Power off has been requested while we were waiting */
+        GDEBUG("Opps, we don't need the power anymore");
+        self->recovery_start = 0;
+        if (!self->close_timer_id) {
+            binder_nfc_adapter_close(self);
+        }
+        return;
+    }
+    if (self->recovery_start) {
+        const gint64 us = g_get_monotonic_time() - self->recovery_start;
+
+        self->recovery_start = 0;
+        binder_nfc_histogram_add(&self->recovery_time, us);
+        GINFO("HAL recovered in %u ms", (guint)(us / 1000));
+        if (self->power_on && !self->power_switch_pending) {
+            /* nfcd doesn't need to know, just reinitialize NCI */
+            nci_core_restart(self->adapter.nci);
+            return;
+        }
+    }
     GDEBUG("Power on");
     binder_nfc_adapter_set_power(self, TRUE);
 }
@@ -280,6 +751,64 @@ binder_nfc_adapter_open_cancel(
     binder_nfc_adapter_close(self);
 }
 
+static
+void
+binder_nfc_adapter_open_failed(
+    BinderNfcAdapter* self)
+{
+    GWARN("Power on error");
+    binder_nfc_adapter_dump_recorder(self, "open failed");
+    if (self->recovery_start) {
+        GWARN("HAL recovery failed");
+        self->recovery_start = 0;
+        self->recovery_failures++;
+    }
+    self->open_cplt = NULL;
+    binder_nfc_adapter_set_power(self, FALSE);
+    binder_nfc_timeline_finish(&self->timeline);
+}
+
+/*
+ * If open() or OPEN_CPLT times out, we don't really know what state
+ * the HAL is in. It may well be open, so it gets closed (best effort)
+ * before nfcd is told that the power is off.
+ */
+
+static
+void
+binder_nfc_adapter_open_abort_complete(
+    BinderNfcApi* api,
+    gboolean success,
+    void* user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+
+    GASSERT(self->pending_tx);
+    BINDER_TRACE2(close_complete, self->pending_tx, success);
+    self->pending_tx = 0;
+    GDEBUG("Abandoned open %s", success ? "closed" : "failed to close");
+    binder_nfc_adapter_open_failed(self);
+}
+
+static
+void
+binder_nfc_adapter_open_abort(
+    BinderNfcAdapter* self)
+{
+    GASSERT(!self->pending_tx);
+    self->open_cplt = NULL;
+    self->close_type = BINDER_NFC_CLOSE_DISABLE;
+    self->pending_tx = binder_nfc_api_close(self->api, self->close_type,
+        binder_nfc_adapter_open_abort_complete, NULL, self);
+    BINDER_TRACE1(close, self->pending_tx);
+    if (self->pending_tx) {
+        binder_nfc_adapter_watch_tx(self,
+            binder_nfc_adapter_open_abort_complete);
+    } else {
+        binder_nfc_adapter_open_failed(self);
+    }
+}
+
 static
 void
 binder_nfc_adapter_open_complete(
@@ -290,18 +819,19 @@ binder_nfc_adapter_open_complete(
     BinderNfcAdapter* self = THIS(user_data);
 
     GASSERT(self->pending_tx);
+    BINDER_TRACE2(open_complete, self->pending_tx, success);
     self->pending_tx = 0;
+    binder_nfc_timeline_mark(&self->timeline, BINDER_NFC_POWER_PHASE_OPEN);
     if (self->need_power) {
         if (success) {
             if (self->open_cplt) {
                 GDEBUG("Waiting for OPEN_CPLT");
+                binder_nfc_adapter_watch_event(self);
             } else {
                 binder_nfc_adapter_open_done(self);
             }
         } else {
-            GWARN("Power on error");
-            self->open_cplt = NULL;
-            binder_nfc_adapter_set_power(self, FALSE);
+            binder_nfc_adapter_open_failed(self);
         }
     } else {
         GDEBUG("Opps, we don't need the power anymore");
@@ -318,11 +848,21 @@ gboolean
 binder_nfc_adapter_open(
     BinderNfcAdapter* self)
 {
-    GDEBUG("Opening adapter");
+    if (self->switched_off) {
+        GDEBUG("Resuming from host-switched-off state");
+        self->switched_off = FALSE;
+        self->switched_off_resumes++;
+    } else {
+        GDEBUG("Opening adapter");
+    }
+    binder_nfc_framer_reset(&self->framer);
+    binder_nfc_adapter_early_read_clear(self);
     self->core_initialized = FALSE;
     self->open_cplt = binder_nfc_adapter_open_cplt;
     self->pending_tx = binder_nfc_api_open(self->api,
         binder_nfc_adapter_open_complete, NULL, self);
+    BINDER_TRACE1(open, self->pending_tx);
+    binder_nfc_adapter_watch_tx(self, binder_nfc_adapter_open_complete);
     return (self->pending_tx != 0);
 }
 
@@ -332,7 +872,7 @@ binder_nfc_adapter_reopen_cplt(
     BinderNfcAdapter* self)
 {
     GASSERT(!self->pending_tx);
-    self->pending_tx = binder_nfc_adapter_open(self);
+    binder_nfc_adapter_open(self);
 }
 
 static
@@ -341,6 +881,7 @@ binder_nfc_adapter_close_done(
     BinderNfcAdapter* self)
 {
     GDEBUG("Power off");
+    self->recovery_start = 0; /* No longer needed */
     binder_nfc_adapter_set_power(self, FALSE);
 }
 
@@ -367,16 +908,18 @@ binder_nfc_adapter_close_complete(
     BinderNfcAdapter* self = THIS(user_data);
 
     GASSERT(self->pending_tx);
-    GASSERT(self->power_on);
 
+    BINDER_TRACE2(close_complete, self->pending_tx, success);
     self->pending_tx = 0;
+    binder_nfc_timeline_mark(&self->timeline, BINDER_NFC_POWER_PHASE_CLOSE);
     if (self->need_power) {
         /* Reopen the adapter */
         GDEBUG("Opps, we need the power");
         if (self->close_cplt) {
             self->close_cplt = binder_nfc_adapter_reopen_cplt;
+            binder_nfc_adapter_watch_event(self);
         } else {
-            self->pending_tx = binder_nfc_adapter_open(self);
+            binder_nfc_adapter_open(self);
         }
     } else {
         if (success) {
@@ -385,16 +928,48 @@ binder_nfc_adapter_close_complete(
              * when it does come, it usually comes before completion of the
              * close() call.
              */
+            self->switched_off = (self->close_type ==
+                BINDER_NFC_CLOSE_HOST_SWITCHED_OFF);
             self->close_cplt = NULL;
             binder_nfc_adapter_close_done(self);
+        } else if (self->close_type == BINDER_NFC_CLOSE_HOST_SWITCHED_OFF) {
+            /* Most likely, closeForPowerOffCase() isn't supported */
+            GWARN("Host-switched-off close failed, closing normally");
+            self->host_switched_off_broken = TRUE;
+            self->close_cplt = NULL;
+            if (!binder_nfc_adapter_close(self)) {
+                binder_nfc_adapter_close_done(self);
+            }
         } else {
             GWARN("Power off error");
+            binder_nfc_adapter_dump_recorder(self, "close failed");
             self->close_cplt = NULL;
             binder_nfc_adapter_close_done(self);
         }
     }
 }
 
+static
+void
+binder_nfc_adapter_cancel_detached(
+    BinderNfcAdapter* self)
+{
+    GBinderClient* client = self->api->client;
+
+    if (self->core_initialized_tx) {
+        if (self->core_initialized_tx != self->pending_tx) {
+            gbinder_client_cancel(client, self->core_initialized_tx);
+        }
+        self->core_initialized_tx = 0;
+    }
+    if (self->prediscover_tx) {
+        if (self->prediscover_tx != self->pending_tx) {
+            gbinder_client_cancel(client, self->prediscover_tx);
+        }
+        self->prediscover_tx = 0;
+    }
+}
+
 static
 gboolean
 binder_nfc_adapter_close(
@@ -412,28 +987,147 @@ binder_nfc_adapter_close(
         nci_core_set_state(nci, NCI_RFST_IDLE);
     }
 
-    GDEBUG("Closing adapter");
+    /*
+     * If NFC is still enabled and nfcd simply doesn't need the power
+     * at the moment, the controller can be left in the low-power
+     * host-switched-off state (if configured and supported).
+     */
+    if (self->host_switched_off && !self->host_switched_off_broken &&
+        !self->need_power && NFC_ADAPTER(self)->enabled) {
+        GDEBUG("Switching adapter off");
+        self->close_type = BINDER_NFC_CLOSE_HOST_SWITCHED_OFF;
+    } else {
+        GDEBUG("Closing adapter");
+        self->close_type = BINDER_NFC_CLOSE_DISABLE;
+    }
     GASSERT(!self->pending_tx);
+    binder_nfc_adapter_cancel_detached(self);
     self->close_cplt = binder_nfc_adapter_close_cplt;
-    self->pending_tx = binder_nfc_api_close(self->api,
+    self->pending_tx = binder_nfc_api_close(self->api, self->close_type,
         binder_nfc_adapter_close_complete, NULL, self);
+    BINDER_TRACE1(close, self->pending_tx);
+    binder_nfc_adapter_watch_tx(self, binder_nfc_adapter_close_complete);
     return (self->pending_tx != 0);
 }
 
+/*
+ * With non-zero close_delay_ms, the HAL is kept open for a while after
+ * nfcd has been told that the power is off. If the power is requested
+ * again within that period, the adapter gets back to work without
+ * a close/open cycle.
+ */
+
 static
-void
-binder_nfc_adapter_power_check(
-    BinderNfcAdapter* self)
+gboolean
+binder_nfc_adapter_close_timeout(
+    gpointer user_data)
 {
-    if (self->power_on && !self->need_power && !self->pending_tx) {
-        if (binder_nfc_adapter_can_close(self)) {
+    BinderNfcAdapter* self = THIS(user_data);
+
+    self->close_timer_id = 0;
+    if (!self->need_power) {
+        if (self->pending_tx || self->warm_notify_id) {
+            /* Nothing else is going to close the HAL, try again later */
+            GDEBUG("Keep-warm period is over, waiting to close");
+            self->close_timer_id = g_timeout_add(BINDER_NFC_CLOSE_RETRY_MS,
+                binder_nfc_adapter_close_timeout, self);
+        } else {
+            GDEBUG("Keep-warm period is over");
             binder_nfc_adapter_close(self);
         }
     }
+    return G_SOURCE_REMOVE;
 }
 
 static
-void
+gboolean
+binder_nfc_adapter_warm_notify(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+    NciCore* nci = self->adapter.nci;
+    const gboolean on = self->need_power;
+    const gboolean requested = self->power_switch_pending;
+
+    /* The HAL has never been closed, only nfcd has to be notified */
+    self->warm_notify_id = 0;
+    self->power_switch_pending = FALSE;
+    if (requested || self->power_on != on) {
+        GDEBUG("Power %s (warm)", on ? "on" : "off");
+        self->power_on = on;
+        if (on) {
+            nci_core_set_state(nci, NCI_RFST_IDLE);
+        }
+        BINDER_TRACE2(power, on, requested);
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_NOTIFY);
+        nfc_adapter_power_notify(NFC_ADAPTER(self), on, requested);
+    }
+    binder_nfc_adapter_loop_probe_check(self);
+    binder_nfc_adapter_state_check(self);
+    return G_SOURCE_REMOVE;
+}
+
+static
+gboolean
+binder_nfc_adapter_warm_switch(
+    BinderNfcAdapter* self,
+    gboolean on)
+{
+    if (on) {
+        if (self->close_timer_id) {
+            GDEBUG("Cancelling deferred close");
+            g_source_remove(self->close_timer_id);
+            self->close_timer_id = 0;
+            self->warm_resumes++;
+        }
+    } else if (!self->close_timer_id) {
+        NciCore* nci = self->adapter.nci;
+
+        /*
+         * nfcd is about to be told that the power is off, make sure
+         * that the state machine doesn't go on to RFST_DISCOVERY,
+         * the same way binder_nfc_adapter_close() does.
+         */
+        if (nci->current_state >= NCI_RFST_IDLE) {
+            nci_core_set_state(nci, NCI_RFST_IDLE);
+        }
+        GDEBUG("Deferring close by %u ms", self->close_delay_ms);
+        self->close_timer_id = g_timeout_add(self->close_delay_ms,
+            binder_nfc_adapter_close_timeout, self);
+    }
+    if (!self->warm_notify_id) {
+        self->warm_notify_id = g_idle_add(binder_nfc_adapter_warm_notify,
+            self);
+    }
+    return TRUE;
+}
+
+static
+gboolean
+binder_nfc_adapter_close_or_defer(
+    BinderNfcAdapter* self)
+{
+    return self->close_delay_ms ?
+        binder_nfc_adapter_warm_switch(self, FALSE) :
+        binder_nfc_adapter_close(self);
+}
+
+static
+void
+binder_nfc_adapter_power_check(
+    BinderNfcAdapter* self)
+{
+    if (self->power_on && !self->need_power && !self->pending_tx &&
+        !self->warm_notify_id) {
+        if (binder_nfc_adapter_can_close(self)) {
+            binder_nfc_adapter_close_or_defer(self);
+        }
+    }
+}
+
+static
+void
 binder_nfc_adapter_prediscover_complete(
     BinderNfcApi* api,
     gboolean ok,
@@ -441,9 +1135,20 @@ binder_nfc_adapter_prediscover_complete(
 {
     BinderNfcAdapter* self = THIS(user_data);
     NciCore* nci = self->adapter.nci;
+    const gboolean detached = (self->pending_tx != self->prediscover_tx);
+
+    self->prediscover_tx = 0;
+    if (detached) {
+        /* PRE_DISCOVER_CPLT has already moved us on */
+        GDEBUG("PREDISCOVER %s (late)", ok ? "ok" : "failed");
+        binder_nfc_adapter_state_check(self);
+        return;
+    }
 
     GDEBUG("PREDISCOVER %s", ok ? "ok" : "failed (that's ok)");
     self->pending_tx = 0;
+    binder_nfc_timeline_mark(&self->timeline,
+        BINDER_NFC_POWER_PHASE_PREDISCOVER);
     nci_core_set_state(nci, NCI_RFST_DISCOVERY);
     binder_nfc_adapter_state_check(self);
 }
@@ -456,9 +1161,20 @@ binder_nfc_adapter_core_initialized_complete(
     void* user_data)
 {
     BinderNfcAdapter* self = THIS(user_data);
+    const gboolean detached = (self->pending_tx != self->core_initialized_tx);
+
+    self->core_initialized_tx = 0;
+    if (detached) {
+        /* POST_INIT_CPLT has already moved us on */
+        GDEBUG("CORE_INITIALIZED %s (late)", ok ? "ok" : "failed");
+        binder_nfc_adapter_state_check(self);
+        return;
+    }
 
     GDEBUG("CORE_INITIALIZED %s", ok ? "ok" : "failed (that's ok)");
     self->pending_tx = 0;
+    binder_nfc_timeline_mark(&self->timeline,
+        BINDER_NFC_POWER_PHASE_CORE_INITIALIZED);
     binder_nfc_adapter_state_check(self);
 }
 
@@ -469,30 +1185,343 @@ binder_nfc_adapter_nci_check(
 {
     NciCore* nci = self->adapter.nci;
 
-    if (self->power_on && self->need_power && !self->pending_tx) {
+    /* Nothing to do until OPEN_CPLT arrives */
+    if (self->power_on && self->need_power && !self->pending_tx &&
+        !self->open_cplt) {
         if (nci->current_state == NCI_RFST_IDLE &&
             nci->next_state == NCI_RFST_IDLE) {
             if (!self->core_initialized) {
                 self->core_initialized = TRUE;
-                self->pending_tx = binder_nfc_api_core_initialized(self->api,
-                    binder_nfc_adapter_core_initialized_complete, NULL, self);
-            } else {
+                self->core_initialized_tx = self->pending_tx =
+                    binder_nfc_api_core_initialized(self->api,
+                        binder_nfc_adapter_core_initialized_complete, NULL,
+                        self);
+                binder_nfc_adapter_watch_tx(self,
+                    binder_nfc_adapter_core_initialized_complete);
+            } else if (!self->prediscover_tx) {
                 /* This includes both first time initialization and the case
                  * when NCI state machine has switched to IDLE by itself. */
-                self->pending_tx = binder_nfc_api_prediscover(self->api,
-                    binder_nfc_adapter_prediscover_complete, NULL, self);
+                self->prediscover_tx = self->pending_tx =
+                    binder_nfc_api_prediscover(self->api,
+                        binder_nfc_adapter_prediscover_complete, NULL, self);
+                binder_nfc_adapter_watch_tx(self,
+                    binder_nfc_adapter_prediscover_complete);
             }
         }
     }
 }
 
+/*
+ * Some HALs send POST_INIT_CPLT and PRE_DISCOVER_CPLT events well before
+ * replying to coreInitialized() and prediscover() calls. Once the event
+ * has arrived, there's no need to wait for the reply, the transaction
+ * gets detached and its completion is ignored.
+ */
+
+static
+void
+binder_nfc_adapter_post_init_cplt(
+    BinderNfcAdapter* self)
+{
+    if (self->core_initialized_tx &&
+        self->pending_tx == self->core_initialized_tx) {
+        GDEBUG("Not waiting for CORE_INITIALIZED reply");
+        self->pending_tx = 0;
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_CORE_INITIALIZED);
+        binder_nfc_adapter_state_check(self);
+    }
+}
+
+static
+void
+binder_nfc_adapter_pre_discover_cplt(
+    BinderNfcAdapter* self)
+{
+    NciCore* nci = self->adapter.nci;
+
+    if (self->prediscover_tx && self->pending_tx == self->prediscover_tx) {
+        GDEBUG("Not waiting for PREDISCOVER reply");
+        self->pending_tx = 0;
+        binder_nfc_timeline_mark(&self->timeline,
+            BINDER_NFC_POWER_PHASE_PREDISCOVER);
+        nci_core_set_state(nci, NCI_RFST_DISCOVERY);
+        binder_nfc_adapter_state_check(self);
+    }
+}
+
+/*
+ * In-place recovery from HAL errors. The controller gets power cycled
+ * (or, if the HAL doesn't support that, the HAL is closed and reopened)
+ * and the NCI core gets restarted, while the NfcAdapter stays registered
+ * with NfcManager and nfcd keeps thinking that the power is on.
+ */
+
+static
+void
+binder_nfc_adapter_power_cycle_complete(
+    BinderNfcApi* api,
+    gboolean success,
+    void* user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+
+    GASSERT(self->pending_tx);
+    BINDER_TRACE2(power_cycle_complete, self->pending_tx, success);
+    self->pending_tx = 0;
+    if (success) {
+        self->power_cycles++;
+        if (!self->need_power) {
+            /* Same as in binder_nfc_adapter_open_complete() */
+            GDEBUG("Opps, we don't need the power anymore");
+            if (self->open_cplt) {
+                self->open_cplt = binder_nfc_adapter_open_cancel;
+            } else {
+                binder_nfc_adapter_close(self);
+            }
+        } else if (self->open_cplt) {
+            GDEBUG("Waiting for OPEN_CPLT");
+            binder_nfc_adapter_watch_event(self);
+        } else {
+            binder_nfc_adapter_open_done(self);
+        }
+    } else {
+        if (binder_nfc_api_power_cycle_unsupported(api)) {
+            /* Don't try it again */
+            GWARN("Power cycle is not supported");
+            self->power_cycle_broken = TRUE;
+        } else {
+            /* Failed or timed out, this time fall back to close/open */
+            GWARN("Power cycle failed");
+            self->power_cycle_skip = TRUE;
+        }
+        self->open_cplt = NULL;
+        self->recovery_pending = TRUE;
+        binder_nfc_adapter_state_check(self);
+    }
+}
+
+static
+gboolean
+binder_nfc_adapter_power_cycle(
+    BinderNfcAdapter* self)
+{
+    if (self->power_cycle_skip) {
+        self->power_cycle_skip = FALSE;
+    } else if (!self->power_cycle_broken) {
+        GDEBUG("Power cycling the controller");
+        self->core_initialized = FALSE;
+        self->open_cplt = binder_nfc_adapter_open_cplt;
+        self->pending_tx = binder_nfc_api_power_cycle(self->api,
+            binder_nfc_adapter_power_cycle_complete, NULL, self);
+        BINDER_TRACE1(power_cycle, self->pending_tx);
+        if (self->pending_tx) {
+            binder_nfc_adapter_watch_tx(self,
+                binder_nfc_adapter_power_cycle_complete);
+            return TRUE;
+        }
+        self->open_cplt = NULL;
+        self->power_cycle_broken = TRUE;
+    }
+    return FALSE;
+}
+
+static
+void
+binder_nfc_adapter_recover(
+    BinderNfcAdapter* self,
+    const char* reason)
+{
+    if (self->power_on && self->need_power) {
+        if (self->recovery_start) {
+            GDEBUG("%s, already recovering", reason);
+        } else {
+            GWARN("%s, resetting the HAL", reason);
+            binder_nfc_adapter_dump_recorder(self, reason);
+            self->recovery_start = g_get_monotonic_time();
+            self->recovery_pending = TRUE;
+            binder_nfc_adapter_state_check(self);
+        }
+    } else {
+        GDEBUG("%s (ignored)", reason);
+    }
+}
+
+static
+void
+binder_nfc_adapter_recovery_check(
+    BinderNfcAdapter* self)
+{
+    if (self->recovery_pending && !self->pending_tx) {
+        self->recovery_pending = FALSE;
+        if (self->power_on && self->need_power) {
+            if (!binder_nfc_adapter_power_cycle(self)) {
+                /* close_complete() reopens the HAL since we need power */
+                binder_nfc_adapter_close(self);
+            }
+        } else {
+            self->recovery_start = 0;
+        }
+    }
+}
+
 static
 void
 binder_nfc_adapter_state_check(
     BinderNfcAdapter* self)
 {
-    binder_nfc_adapter_nci_check(self);
-    binder_nfc_adapter_power_check(self);
+    /* Nothing can be done until the HAL is back */
+    if (!self->disconnected) {
+        binder_nfc_adapter_recovery_check(self);
+        binder_nfc_adapter_nci_check(self);
+        binder_nfc_adapter_power_check(self);
+    }
+}
+
+/*
+ * Deadlines. There's a single timer for whatever the state machine is
+ * currently waiting for, either the reply to pending_tx or OPEN_CPLT
+ * or CLOSE_CPLT event. The timer isn't stopped when the reply arrives,
+ * it simply does nothing if there's nothing to wait for anymore.
+ */
+
+static
+gboolean
+binder_nfc_adapter_call_timeout(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+    const gulong id = self->watched_tx;
+
+    self->call_timer_id = 0;
+    self->watched_tx = 0;
+    if (id) {
+        if (id == self->pending_tx) {
+            BinderNfcApiCompleteFunc complete = self->watched_tx_complete;
+
+            GWARN("HAL call timed out");
+            binder_nfc_adapter_dump_recorder(self, "call timeout");
+            self->call_timeouts++;
+            gbinder_client_cancel(self->api->client, id);
+            if (complete == binder_nfc_adapter_open_complete) {
+                self->pending_tx = 0;
+                binder_nfc_adapter_open_abort(self);
+            } else {
+                if (id == self->core_initialized_tx ||
+                    id == self->prediscover_tx) {
+                    /* Reset the HAL once this call is out of the way */
+                    binder_nfc_adapter_recover(self, "HAL call timeout");
+                }
+                complete(self->api, FALSE, self);
+            }
+        }
+    } else if (!self->pending_tx) {
+        BinderNfcAdapterFunc action = NULL;
+
+        if (self->open_cplt) {
+            GWARN("OPEN_CPLT timed out");
+            action = (self->open_cplt == binder_nfc_adapter_open_cplt) ?
+                binder_nfc_adapter_open_abort : self->open_cplt;
+            self->open_cplt = NULL;
+        } else if (self->close_cplt) {
+            /* CLOSE_CPLT is optional anyway, just move on */
+            GDEBUG("CLOSE_CPLT timed out");
+            action = self->close_cplt;
+            self->close_cplt = NULL;
+        }
+        if (action) {
+            self->event_timeouts++;
+            action(self);
+        }
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_adapter_watch(
+    BinderNfcAdapter* self,
+    gulong id,
+    BinderNfcApiCompleteFunc complete)
+{
+    if (self->call_timer_id) {
+        g_source_remove(self->call_timer_id);
+        self->call_timer_id = 0;
+    }
+    self->watched_tx = id;
+    self->watched_tx_complete = complete;
+    if (self->call_timeout_ms) {
+        self->call_timer_id = g_timeout_add(self->call_timeout_ms,
+            binder_nfc_adapter_call_timeout, self);
+    }
+}
+
+static
+void
+binder_nfc_adapter_watch_tx(
+    BinderNfcAdapter* self,
+    BinderNfcApiCompleteFunc complete)
+{
+    if (self->pending_tx) {
+        binder_nfc_adapter_watch(self, self->pending_tx, complete);
+    }
+}
+
+static
+void
+binder_nfc_adapter_watch_event(
+    BinderNfcAdapter* self)
+{
+    binder_nfc_adapter_watch(self, 0, NULL);
+}
+
+/*
+ * When the HAL dies, the adapter stays around (as far as nfcd is
+ * concerned, the power is still on if it was on) until the plugin
+ * either hands it a new api object or gives up and drops it.
+ */
+
+static
+void
+binder_nfc_adapter_disconnect(
+    BinderNfcAdapter* self)
+{
+    GBinderClient* client = self->api->client;
+
+    self->disconnected = TRUE;
+    self->death_time = g_get_monotonic_time();
+
+    /* Whatever was going on isn't going to complete */
+    if (self->close_timer_id) {
+        g_source_remove(self->close_timer_id);
+        self->close_timer_id = 0;
+    }
+    if (self->warm_notify_id) {
+        g_source_remove(self->warm_notify_id);
+        self->warm_notify_id = 0;
+    }
+    if (self->call_timer_id) {
+        g_source_remove(self->call_timer_id);
+        self->call_timer_id = 0;
+    }
+    self->watched_tx = 0;
+    binder_nfc_framer_reset(&self->framer);
+    binder_nfc_adapter_read_discard(self);
+    binder_nfc_adapter_early_read_clear(self);
+    binder_nfc_adapter_write_cancel_all(self);
+    binder_nfc_adapter_cancel_detached(self);
+    gbinder_client_cancel(client, self->pending_tx);
+    self->pending_tx = 0;
+    self->switched_off = FALSE;
+    self->open_cplt = NULL;
+    self->close_cplt = NULL;
+    self->recovery_pending = FALSE;
+    self->recovery_start = 0;
+
+    if (self->power_on && !self->need_power) {
+        /* There's nothing left to close */
+        binder_nfc_adapter_set_power(self, FALSE);
+    }
 }
 
 static
@@ -501,27 +1530,103 @@ binder_nfc_adapter_death(
     GBinderRemoteObject* remote,
     void* self)
 {
+    binder_nfc_adapter_dump_recorder(THIS(self), "HAL died");
+    binder_nfc_adapter_disconnect(THIS(self));
     g_signal_emit(THIS(self), binder_nfc_adapter_signals[SIGNAL_DEATH], 0);
 }
 
+static
+void
+binder_nfc_adapter_attach_api(
+    BinderNfcAdapter* self,
+    BinderNfcApi* api)
+{
+    g_object_ref(self->api = api);
+    binder_nfc_api_set_keep_callback(api, self->keep_callback);
+    self->event_id = binder_nfc_api_add_event_handler(api,
+        BINDER_NFC_EVENT_ANY, binder_nfc_adapter_handle_event, self);
+    self->data_id = binder_nfc_api_add_data_handler(api,
+        binder_nfc_adapter_handle_data, self);
+}
+
+static
+void
+binder_nfc_adapter_detach_api(
+    BinderNfcAdapter* self)
+{
+    BinderNfcApi* api = self->api;
+
+    gbinder_remote_object_remove_handler(api->remote, self->death_id);
+    binder_nfc_api_remove_handler(api, self->event_id);
+    binder_nfc_api_remove_handler(api, self->data_id);
+    self->event_id = self->data_id = 0;
+    self->api = NULL;
+    g_object_unref(api);
+}
+
 /*==========================================================================*
  * Internal API
  *==========================================================================*/
 
 NfcAdapter*
 binder_nfc_adapter_new(
-    BinderNfcApi* api)
+    BinderNfcApi* api,
+    const BinderNfcConfig* config)
 {
     BinderNfcAdapter* self = g_object_new(THIS_TYPE, NULL);
 
-    g_object_ref(self->api = api);
-    self->event_id = binder_nfc_api_add_event_handler(api,
-        BINDER_NFC_EVENT_ANY, binder_nfc_adapter_handle_event, self);
-    self->data_id = binder_nfc_api_add_data_handler(api,
-        binder_nfc_adapter_handle_data, self);
+    self->write_queue_max = config->write_queue;
+    self->close_delay_ms = config->close_delay_ms;
+    self->host_switched_off = config->host_switched_off;
+    self->call_timeout_ms = config->call_timeout_ms;
+    self->write_timeout_ms = config->write_timeout_ms;
+    self->loop_probe_ms = config->loop_probe_ms;
+    self->batch_reads = config->batch_reads;
+    self->reassemble = config->reassemble_packets;
+    self->keep_callback = config->keep_callback;
+    binder_nfc_adapter_attach_api(self, api);
     return NFC_ADAPTER(self);
 }
 
+void
+binder_nfc_adapter_set_api(
+    NfcAdapter* adapter,
+    BinderNfcApi* api)
+{
+    if (G_LIKELY(adapter) && G_LIKELY(api)) {
+        BinderNfcAdapter* self = THIS(adapter);
+        const gboolean watch_death = (self->death_id != 0);
+
+        if (self->api == api) {
+            return;
+        }
+        if (!self->disconnected) {
+            binder_nfc_adapter_disconnect(self);
+        }
+        binder_nfc_api_take_stats(api, self->api);
+        binder_nfc_adapter_detach_api(self);
+        binder_nfc_adapter_attach_api(self, api);
+        if (watch_death) {
+            self->death_id = gbinder_remote_object_add_death_handler
+                (api->remote, binder_nfc_adapter_death, self);
+        }
+
+        /* The new HAL instance starts closed, restore the power state */
+        self->disconnected = FALSE;
+        if (self->need_power) {
+            if (self->power_on) {
+                /* Same as in-place recovery, nfcd won't notice */
+                self->recovery_start = self->death_time;
+            }
+            if (!binder_nfc_adapter_open(self)) {
+                binder_nfc_adapter_open_failed(self);
+            }
+        } else if (self->power_on) {
+            binder_nfc_adapter_set_power(self, FALSE);
+        }
+    }
+}
+
 gulong
 binder_nfc_adapter_add_death_handler(
     NfcAdapter* adapter,
@@ -540,6 +1645,67 @@ binder_nfc_adapter_add_death_handler(
     return 0;
 }
 
+void
+binder_nfc_adapter_dump(
+    NfcAdapter* adapter)
+{
+    if (G_LIKELY(adapter)) {
+        BinderNfcAdapter* self = THIS(adapter);
+
+        binder_nfc_api_dump_stats(self->api, adapter->name);
+        GINFO("%s write pool: %u allocated", adapter->name,
+            self->write_pool_allocated);
+        if (self->close_delay_ms) {
+            GINFO("%s: %u warm resume(s)", adapter->name,
+                self->warm_resumes);
+        }
+        if (self->call_timeouts || self->event_timeouts ||
+            self->write_timeouts) {
+            GINFO("%s: timeouts: %u call(s), %u event(s), %u write(s)",
+                adapter->name, self->call_timeouts, self->event_timeouts,
+                self->write_timeouts);
+        }
+        if (self->host_switched_off) {
+            GINFO("%s: %u resume(s) from host-switched-off state%s",
+                adapter->name, self->switched_off_resumes,
+                self->host_switched_off_broken ? " (not supported)" : "");
+        }
+        if (self->recovery_time.count || self->recovery_failures) {
+            const BinderNfcHistogram* hist = &self->recovery_time;
+
+            GINFO("%s: %u HAL recoveries (%u power cycles), avg %"
+                G_GINT64_FORMAT " max %" G_GINT64_FORMAT " us; %u failed",
+                adapter->name, hist->count, self->power_cycles,
+                binder_nfc_histogram_average(hist), hist->max,
+                self->recovery_failures);
+        }
+        if (self->framer.split || self->framer.dropped) {
+            GINFO("%s: %u irregular payload(s), %u packet(s) reassembled, "
+                "%u dropped", adapter->name, self->framer.split,
+                self->framer.joined, self->framer.dropped);
+        }
+        if (self->early_replayed || self->early_dropped) {
+            GINFO("%s: early packets: %u replayed, %u dropped",
+                adapter->name, self->early_replayed, self->early_dropped);
+        }
+        if (self->read_batches) {
+            GINFO("%s: %u packet(s) delivered in %u batch(es)",
+                adapter->name, self->read_batched, self->read_batches);
+        }
+        if (self->loop_lag.count) {
+            const BinderNfcHistogram* hist = &self->loop_lag;
+
+            GINFO("%s: main loop lag avg %" G_GINT64_FORMAT " p99 %"
+                G_GINT64_FORMAT " max %" G_GINT64_FORMAT " us (%u samples)",
+                adapter->name, binder_nfc_histogram_average(hist),
+                binder_nfc_histogram_percentile(hist, 990), hist->max,
+                hist->count);
+        }
+        binder_nfc_timeline_dump(&self->timeline, adapter->name);
+        binder_nfc_adapter_dump_recorder(self, "on request");
+    }
+}
+
 /*==========================================================================*
  * Methods
  *==========================================================================*/
@@ -549,8 +1715,22 @@ void
 binder_nfc_adapter_current_state_changed(
     NciAdapter* adapter)
 {
+    BinderNfcAdapter* self = THIS(adapter);
+    NciCore* nci = adapter->nci;
+
     NCI_ADAPTER_CLASS(PARENT_CLASS)->current_state_changed(adapter);
-    binder_nfc_adapter_state_check(THIS(adapter));
+    if (nci->current_state == NCI_STATE_ERROR && !self->disconnected) {
+        /* The controller needs a reset but let's not do it forever */
+        if (self->nci_errors < BINDER_NFC_MAX_NCI_ERRORS) {
+            self->nci_errors++;
+            binder_nfc_adapter_recover(self, "NCI error");
+        } else {
+            GWARN("Too many NCI errors in a row, giving up");
+        }
+    } else if (nci->current_state > NCI_RFST_IDLE) {
+        self->nci_errors = 0;
+    }
+    binder_nfc_adapter_state_check(self);
 }
 
 static
@@ -571,8 +1751,16 @@ binder_nfc_adapter_submit_power_request(
     BinderNfcAdapter* self = THIS(adapter);
     NciCore* nci = self->adapter.nci;
 
+    binder_nfc_timeline_start(&self->timeline, on);
     self->need_power = on;
-    if (self->pending_tx) {
+    if (self->disconnected) {
+        /* Will be sorted out when (and if) the HAL comes back */
+        GDEBUG("Waiting for the HAL to come back");
+        self->power_switch_pending = (self->power_on != on);
+    } else if (self->close_timer_id || self->warm_notify_id) {
+        /* The HAL is still open, the last request wins */
+        self->power_switch_pending = binder_nfc_adapter_warm_switch(self, on);
+    } else if (self->pending_tx) {
         GDEBUG("Waiting for pending call to complete");
         self->power_switch_pending = TRUE;
     } else if (on) {
@@ -586,7 +1774,8 @@ binder_nfc_adapter_submit_power_request(
     } else {
         if (self->power_on) {
             if (binder_nfc_adapter_can_close(self)) {
-                self->power_switch_pending = binder_nfc_adapter_close(self);
+                self->power_switch_pending =
+                    binder_nfc_adapter_close_or_defer(self);
             } else {
                 GDEBUG("Waiting for NCI state machine to become idle");
                 nci_core_set_state(nci, NCI_RFST_IDLE);
@@ -611,16 +1800,42 @@ binder_nfc_adapter_cancel_power_request(
 
     self->need_power = self->power_on;
     self->power_switch_pending = FALSE;
+    if (self->need_power && self->close_timer_id) {
+        /* Stay open */
+        g_source_remove(self->close_timer_id);
+        self->close_timer_id = 0;
+    }
 }
 
 /*==========================================================================*
  * NFC HAL I/O
  *==========================================================================*/
 
-typedef struct binder_nci_write_data {
+/*
+ * Up to write_queue_max writes can be queued. The NCI core doesn't issue
+ * the next write until the previous one has been completed, so all but
+ * the last queued write get completed before the HAL actually replies.
+ * Transactions are still submitted one after another, because libgbinder
+ * doesn't guarantee the order of concurrent asynchronous transactions.
+ */
+
+struct binder_nci_write_data {
+    BinderNciWriteData* next;  /* Next in the queue or in the pool */
     BinderNfcAdapter* self;
     NciHalClientFunc complete;
-} BinderNciWriteData;
+    gulong id;          /* Non-zero while the transaction is pending */
+    gboolean acked;     /* The NCI core has been told it's done */
+    guint8* data;       /* Copy of the packet, until it's submitted */
+    gsize len;          /* Packet length */
+    guint8 buf[BINDER_NFC_NCI_PACKET_MAX];
+};
+
+static
+void
+binder_nfc_adapter_hal_io_write_complete(
+    BinderNfcApi* api,
+    gboolean success,
+    void* user_data);
 
 static
 BinderNfcAdapter*
@@ -630,12 +1845,209 @@ binder_nfc_adapter_from_nci_hal_io(
     return G_CAST(hal_io, BinderNfcAdapter, hal_io);
 }
 
+static
+BinderNciWriteData*
+binder_nfc_adapter_write_data_new(
+    BinderNfcAdapter* self,
+    NciHalClientFunc complete)
+{
+    BinderNciWriteData* write_data = self->write_pool;
+
+    /* Write contexts are recycled, the pool grows only when necessary */
+    if (write_data) {
+        self->write_pool = write_data->next;
+    } else {
+        write_data = g_slice_new(BinderNciWriteData);
+        self->write_pool_allocated++;
+    }
+    write_data->next = NULL;
+    write_data->self = self;
+    write_data->complete = complete;
+    write_data->id = 0;
+    write_data->acked = FALSE;
+    write_data->data = NULL;
+    write_data->len = 0;
+    return write_data;
+}
+
+static
+void
+binder_nfc_adapter_write_data_free(
+    BinderNciWriteData* write_data)
+{
+    BinderNfcAdapter* self = write_data->self;
+
+    if (write_data->data != write_data->buf) {
+        g_free(write_data->data);
+    }
+    write_data->data = NULL;
+    write_data->next = self->write_pool;
+    self->write_pool = write_data;
+}
+
+static
+void
+binder_nfc_adapter_write_push(
+    BinderNfcAdapter* self,
+    BinderNciWriteData* write_data)
+{
+    if (self->write_tail) {
+        self->write_tail->next = write_data;
+    } else {
+        self->write_head = write_data;
+    }
+    self->write_tail = write_data;
+    self->write_count++;
+}
+
+static
+BinderNciWriteData*
+binder_nfc_adapter_write_pop(
+    BinderNfcAdapter* self)
+{
+    BinderNciWriteData* write_data = self->write_head;
+
+    if (write_data) {
+        self->write_head = write_data->next;
+        if (!self->write_head) {
+            self->write_tail = NULL;
+        }
+        write_data->next = NULL;
+        self->write_count--;
+    }
+    return write_data;
+}
+
+static
+gboolean
+binder_nfc_adapter_write_timeout(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+    BinderNciWriteData* write_data = self->write_head;
+
+    self->write_timer_id = 0;
+    if (write_data && write_data->id) {
+        GWARN("HAL write timed out");
+        self->write_timeouts++;
+        gbinder_client_cancel(self->api->client, write_data->id);
+        binder_nfc_adapter_hal_io_write_complete(self->api, FALSE,
+            write_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_adapter_write_timer_stop(
+    BinderNfcAdapter* self)
+{
+    if (self->write_timer_id) {
+        g_source_remove(self->write_timer_id);
+        self->write_timer_id = 0;
+    }
+}
+
+static
+gboolean
+binder_nfc_adapter_write_submit(
+    BinderNfcAdapter* self,
+    BinderNciWriteData* write_data,
+    const GUtilData* chunks,
+    guint count)
+{
+    write_data->id = binder_nfc_api_write(self->api, chunks, count,
+        binder_nfc_adapter_hal_io_write_complete, NULL, write_data);
+    BINDER_TRACE2(write_submit, write_data->len, write_data->id);
+
+    /* Only one write is in flight at any time */
+    binder_nfc_adapter_write_timer_stop(self);
+    if (write_data->id && self->write_timeout_ms) {
+        self->write_timer_id = g_timeout_add(self->write_timeout_ms,
+            binder_nfc_adapter_write_timeout, self);
+    }
+    return (write_data->id != 0);
+}
+
 static
 void
-binder_nci_adapter_hal_io_write_data_free(
-    gpointer data)
+binder_nfc_adapter_write_next(
+    BinderNfcAdapter* self)
 {
-    g_slice_free1(sizeof(BinderNciWriteData), data);
+    BinderNciWriteData* next = self->write_head;
+
+    if (next && !next->id) {
+        GUtilData chunk;
+
+        chunk.bytes = next->data;
+        chunk.size = next->len;
+        if (!binder_nfc_adapter_write_submit(self, next, &chunk, 1)) {
+            binder_nfc_adapter_hal_io_write_complete(self->api, FALSE, next);
+        }
+    }
+}
+
+static
+void
+binder_nfc_adapter_write_ack(
+    BinderNfcAdapter* self,
+    BinderNciWriteData* write_data)
+{
+    BINDER_TRACE2(write_ack, write_data->len, write_data->id);
+    write_data->acked = TRUE;
+    if (write_data->complete) {
+        write_data->complete(self->hal_client, TRUE);
+    }
+}
+
+static
+gboolean
+binder_nfc_adapter_write_ack_proc(
+    gpointer user_data)
+{
+    BinderNfcAdapter* self = THIS(user_data);
+    BinderNciWriteData* last = self->write_tail;
+
+    self->write_ack_id = 0;
+    if (last && !last->acked) {
+        binder_nfc_adapter_write_ack(self, last);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_adapter_write_ack_check(
+    BinderNfcAdapter* self)
+{
+    BinderNciWriteData* last = self->write_tail;
+
+    /* Only the last write may be waiting for completion */
+    if (last && !last->acked && !self->write_ack_id &&
+        self->write_count < self->write_queue_max) {
+        self->write_ack_id = g_idle_add(binder_nfc_adapter_write_ack_proc,
+            self);
+    }
+}
+
+static
+void
+binder_nfc_adapter_write_cancel_all(
+    BinderNfcAdapter* self)
+{
+    BinderNciWriteData* write_data;
+
+    if (self->write_ack_id) {
+        g_source_remove(self->write_ack_id);
+        self->write_ack_id = 0;
+    }
+    binder_nfc_adapter_write_timer_stop(self);
+    while ((write_data = binder_nfc_adapter_write_pop(self)) != NULL) {
+        if (write_data->id) {
+            gbinder_client_cancel(self->api->client, write_data->id);
+        }
+        binder_nfc_adapter_write_data_free(write_data);
+    }
 }
 
 static
@@ -647,11 +2059,33 @@ binder_nfc_adapter_hal_io_write_complete(
 {
     BinderNciWriteData* write_data = user_data;
     BinderNfcAdapter* self = write_data->self;
+    NciHalClient* hal_client = self->hal_client;
 
-    self->nci_write_id = 0;
-    if (write_data->complete) {
-        write_data->complete(self->hal_client, success);
+    GASSERT(self->write_head == write_data);
+    BINDER_TRACE3(write_complete, write_data->len, write_data->id, success);
+    binder_nfc_adapter_write_pop(self);
+    write_data->id = 0;
+    if (!success) {
+        binder_nfc_adapter_dump_recorder(self, "write failed");
+    }
+
+    /* Keep the HAL busy */
+    binder_nfc_adapter_write_next(self);
+    if (!self->write_head || !self->write_head->id) {
+        binder_nfc_adapter_write_timer_stop(self);
     }
+
+    if (!write_data->acked) {
+        if (write_data->complete) {
+            write_data->complete(hal_client, success);
+        }
+    } else if (!success && hal_client) {
+        /* Too late to fail the write, report it as an I/O error */
+        GWARN("Queued write failed");
+        hal_client->fn->error(hal_client);
+    }
+    binder_nfc_adapter_write_data_free(write_data);
+    binder_nfc_adapter_write_ack_check(self);
 }
 
 static
@@ -663,6 +2097,11 @@ binder_nfc_adapter_hal_io_start(
     BinderNfcAdapter* self = binder_nfc_adapter_from_nci_hal_io(hal_io);
 
     self->hal_client = hal_client;
+    if (self->early_read_count && !self->early_read_id) {
+        /* Not from inside start(), let the NCI core finish starting */
+        self->early_read_id = g_idle_add_full(G_PRIORITY_HIGH,
+            binder_nfc_adapter_early_read_proc, self, NULL);
+    }
     return TRUE;
 }
 
@@ -673,11 +2112,13 @@ binder_nfc_adapter_hal_io_stop(
 {
     BinderNfcAdapter* self = binder_nfc_adapter_from_nci_hal_io(hal_io);
 
-    if (self->nci_write_id) {
-        gbinder_client_cancel(self->api->client, self->nci_write_id);
-        self->nci_write_id = 0;
-    }
+    binder_nfc_adapter_write_cancel_all(self);
     self->hal_client = NULL;
+
+    /* Whatever was read for the stopped core is stale by now */
+    binder_nfc_framer_reset(&self->framer);
+    binder_nfc_adapter_read_discard(self);
+    binder_nfc_adapter_early_read_clear(self);
 }
 
 static
@@ -689,48 +2130,46 @@ binder_nfc_adapter_hal_io_write(
     NciHalClientFunc complete)
 {
     BinderNfcAdapter* self = binder_nfc_adapter_from_nci_hal_io(hal_io);
-    guint len = 0;
-    const guint8* data = NULL;
-    guint8* tmp_buf = NULL;
+    gsize len = 0;
+    guint i;
 
-#pragma message("Add gbinder API to concatenate multiple buffers into one?")
-
-    if (count == 1) {
-        data = chunks->bytes;
-        len = chunks->size;
-    } else {
-        guint i;
-
-        for (i = 0; i < count; i++) {
-            len += chunks[i].size;
-        }
+    for (i = 0; i < count; i++) {
+        len += chunks[i].size;
+    }
 
-        if (len > 0) {
-            guint off = 0;
+    if (len > 0 && !self->disconnected) {
+        BinderNciWriteData* write_data =
+            binder_nfc_adapter_write_data_new(self, complete);
+
+        write_data->len = len;
+
+        BINDER_DUMP_CHUNKS(DIR_OUT, chunks, count);
+        binder_nfc_recorder_add_chunks(&self->recorder, DIR_OUT, chunks,
+            count);
+        if (!self->write_head) {
+            /* Chunks are serialized directly into the binder request */
+            if (!binder_nfc_adapter_write_submit(self, write_data, chunks,
+                count)) {
+                binder_nfc_adapter_write_data_free(write_data);
+                return FALSE;
+            }
+        } else {
+            guint8* ptr = (len <= sizeof(write_data->buf)) ?
+                write_data->buf : g_malloc(len);
 
-            data = tmp_buf = g_malloc(len);
+            /* Will be submitted when the previous writes are done */
+            GASSERT(self->write_tail->acked);
+            write_data->data = ptr;
             for (i = 0; i < count; i++) {
-                memcpy(tmp_buf + off, chunks[i].bytes, chunks[i].size);
-                off += chunks[i].size;
+                memcpy(ptr, chunks[i].bytes, chunks[i].size);
+                ptr += chunks[i].size;
             }
         }
+        binder_nfc_adapter_write_push(self, write_data);
+        binder_nfc_adapter_write_ack_check(self);
+        return TRUE;
     }
-
-    GASSERT(!self->nci_write_id);
-    if (data) {
-        BinderNciWriteData* write_data = g_slice_new(BinderNciWriteData);
-
-        write_data->self = self;
-        write_data->complete = complete;
-
-        BINDER_DUMP(DIR_OUT, data, len);
-        self->nci_write_id = binder_nfc_api_write(self->api, data, len,
-            binder_nfc_adapter_hal_io_write_complete,
-            binder_nci_adapter_hal_io_write_data_free, write_data);
-    }
-
-    g_free(tmp_buf);
-    return (self->nci_write_id != 0);
+    return FALSE;
 }
 
 static
@@ -738,11 +2177,8 @@ void
 binder_nfc_adapter_hal_io_cancel_write(
     NciHalIo* hal_io)
 {
-    BinderNfcAdapter* self = binder_nfc_adapter_from_nci_hal_io(hal_io);
-
-    GASSERT(self->nci_write_id);
-    gbinder_client_cancel(self->api->client, self->nci_write_id);
-    self->nci_write_id = 0;
+    binder_nfc_adapter_write_cancel_all
+        (binder_nfc_adapter_from_nci_hal_io(hal_io));
 }
 
 /*==========================================================================*
@@ -762,6 +2198,7 @@ binder_nfc_adapter_init(
     };
 
     self->hal_io.fn = &hal_io_functions;
+    self->write_queue_max = BINDER_NFC_DEFAULT_WRITE_QUEUE;
     nci_adapter_init_base(&self->adapter, &self->hal_io);
 }
 
@@ -771,14 +2208,31 @@ binder_nfc_adapter_finalize(
     GObject* object)
 {
     BinderNfcAdapter* self = THIS(object);
-    BinderNfcApi* api = self->api;
 
-    gbinder_remote_object_remove_handler(api->remote, self->death_id);
-    gbinder_client_cancel(api->client, self->nci_write_id);
-    gbinder_client_cancel(api->client, self->pending_tx);
-    g_signal_handler_disconnect(api, self->event_id);
-    g_signal_handler_disconnect(api, self->data_id);
-    g_object_unref(api);
+    if (self->close_timer_id) {
+        g_source_remove(self->close_timer_id);
+    }
+    if (self->warm_notify_id) {
+        g_source_remove(self->warm_notify_id);
+    }
+    if (self->call_timer_id) {
+        g_source_remove(self->call_timer_id);
+    }
+    if (self->loop_probe_id) {
+        g_source_remove(self->loop_probe_id);
+    }
+    binder_nfc_adapter_read_discard(self);
+    binder_nfc_adapter_early_read_clear(self);
+    binder_nfc_adapter_write_cancel_all(self);
+    binder_nfc_adapter_cancel_detached(self);
+    while (self->write_pool) {
+        BinderNciWriteData* write_data = self->write_pool;
+
+        self->write_pool = write_data->next;
+        g_slice_free(BinderNciWriteData, write_data);
+    }
+    gbinder_client_cancel(self->api->client, self->pending_tx);
+    binder_nfc_adapter_detach_api(self);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
 
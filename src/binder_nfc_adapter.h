@@ -45,7 +45,8 @@
 
 NfcAdapter*
 binder_nfc_adapter_new(
-    BinderNfcApi* api)
+    BinderNfcApi* api,
+    const BinderNfcConfig* config)
     G_GNUC_INTERNAL;
 
 gulong
@@ -55,6 +56,17 @@ binder_nfc_adapter_add_death_handler(
     void* user_data)
     G_GNUC_INTERNAL;
 
+void
+binder_nfc_adapter_set_api(
+    NfcAdapter* adapter,
+    BinderNfcApi* api)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_adapter_dump(
+    NfcAdapter* adapter)
+    G_GNUC_INTERNAL;
+
 #endif /* BINDER_NFC_ADAPTER_H */
 
 /*
@@ -37,11 +37,14 @@
  */
 
 #include "binder_nfc_api_impl.h"
+#include "binder_nfc_stats.h"
 
 #include <gbinder.h>
 #include <gutil_macros.h>
 #include <gutil_misc.h>
 
+#include <string.h>
+
 #define PARENT_CLASS binder_nfc_api_parent_class
 #define PARENT_TYPE G_TYPE_OBJECT
 #define THIS(obj) BINDER_NFC_API(obj)
@@ -49,40 +52,82 @@
 #define GET_THIS_CLASS(obj) G_TYPE_INSTANCE_GET_CLASS(obj, THIS_TYPE, \
         BinderNfcApiClass)
 
-G_DEFINE_TYPE(BinderNfcApi, binder_nfc_api, PARENT_TYPE)
+typedef struct binder_nfc_api_call_stats {
+    BinderNfcHistogram ok;
+    BinderNfcHistogram failed;
+    guint cancelled;
+} BinderNfcApiCallStats;
+
+typedef struct binder_nfc_api_call_impl BinderNfcApiCallImpl;
+typedef struct binder_nfc_api_handler BinderNfcApiHandler;
 
-enum binder_nfc_api_signal {
-    SIGNAL_EVENT,
-    SIGNAL_DATA,
-    SIGNAL_COUNT
+/*
+ * Plain handler lists instead of GSignal, data handlers get invoked
+ * for every packet coming from the HAL and that has to be cheap.
+ */
+struct binder_nfc_api_handler {
+    BinderNfcApiHandler* next;
+    gulong id;
+    BINDER_NFC_EVENT event;  /* Only for event handlers */
+    GCallback func;          /* NULL if removed during dispatch */
+    gpointer user_data;
 };
 
-#define SIGNAL_EVENT_NAME   "binder-nfc-api-event"
-#define SIGNAL_DATA_NAME    "binder-nfc-api-data"
+struct binder_nfc_api_priv {
+    BinderNfcApiCallStats stats[BINDER_NFC_API_CALL_COUNT];
+    BinderNfcApiCallImpl* free_calls;  /* Pool of unused calls */
+    guint calls_allocated;             /* Number of times pool has grown */
+    BinderNfcApiHandler* event_handlers;
+    BinderNfcApiHandler* data_handlers;
+    gulong last_handler_id;
+    guint dispatching;                 /* Dispatch nesting level */
+    gboolean handlers_removed;         /* Need to drop dead handlers */
+    gboolean keep_callback;            /* Keep callback object after close */
+    gboolean callback_active;          /* Between open and close */
+    guint late_callbacks;              /* Dropped after close */
+    guint unsupported;                 /* Call types rejected by the HAL */
+};
 
-static guint binder_nfc_api_signals[SIGNAL_COUNT] = { 0 };
+G_DEFINE_TYPE_WITH_PRIVATE(BinderNfcApi, binder_nfc_api, PARENT_TYPE)
 
 /*==========================================================================*
  * BinderNfcApiCall
  *==========================================================================*/
 
-typedef struct binder_nfc_api_call_impl {
+struct binder_nfc_api_call_impl {
     BinderNfcApiCall call;
+    BinderNfcApiCallImpl* next;  /* Link in the pool of unused calls */
+    BINDER_NFC_API_CALL_TYPE type;
+    gboolean completed;
+    gint64 submitted;
     BinderNfcApiCompleteFunc complete;
     GDestroyNotify destroy;
     gpointer user_data;
-} BinderNfcApiCallImpl;
+};
 
 BinderNfcApiCall*
 binder_nfc_api_call_new(
     BinderNfcApi* api,
+    BINDER_NFC_API_CALL_TYPE type,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
-    BinderNfcApiCallImpl* impl = g_slice_new(BinderNfcApiCallImpl);
-
+    BinderNfcApiPriv* priv = api->priv;
+    BinderNfcApiCallImpl* impl = priv->free_calls;
+
+    /* Calls are recycled, the pool only grows until it's big enough */
+    if (impl) {
+        priv->free_calls = impl->next;
+    } else {
+        impl = g_slice_new(BinderNfcApiCallImpl);
+        priv->calls_allocated++;
+    }
     g_object_ref(impl->call.api = api);
+    priv->unsupported &= ~(1 << type);
+    impl->type = type;
+    impl->completed = FALSE;
+    impl->submitted = g_get_monotonic_time();
     impl->complete = complete;
     impl->destroy = destroy;
     impl->user_data = user_data;
@@ -95,23 +140,167 @@ binder_nfc_api_call_complete(
     gboolean ok)
 {
     BinderNfcApiCallImpl* impl = G_CAST(call,BinderNfcApiCallImpl,call);
+    BinderNfcApiCallStats* stats = call->api->priv->stats + impl->type;
 
+    impl->completed = TRUE;
+    binder_nfc_histogram_add(ok ? &stats->ok : &stats->failed,
+        g_get_monotonic_time() - impl->submitted);
     if (impl->complete) {
         impl->complete(call->api, ok, impl->user_data);
     }
 }
 
+void
+binder_nfc_api_call_unsupported(
+    BinderNfcApiCall* call)
+{
+    BinderNfcApiCallImpl* impl = G_CAST(call,BinderNfcApiCallImpl,call);
+
+    /* The HAL says it doesn't implement this call */
+    call->api->priv->unsupported |= (1 << impl->type);
+    binder_nfc_api_call_complete(call, FALSE);
+}
+
 void
 binder_nfc_api_call_destroy(
     gpointer call)
 {
     BinderNfcApiCallImpl* impl = call;
+    BinderNfcApi* api = impl->call.api;
+    BinderNfcApiPriv* priv = api->priv;
 
+    if (!impl->completed) {
+        /* Cancelled or dropped without a reply */
+        priv->stats[impl->type].cancelled++;
+    }
     if (impl->destroy) {
         impl->destroy(impl->user_data);
     }
-    g_object_unref(impl->call.api);
-    gutil_slice_free(impl);
+
+    /* Return it to the pool before releasing the reference */
+    impl->next = priv->free_calls;
+    priv->free_calls = impl;
+    g_object_unref(api);
+}
+
+/*==========================================================================*
+ * Handlers
+ *==========================================================================*/
+
+static
+gulong
+binder_nfc_api_handler_add(
+    BinderNfcApi* self,
+    BinderNfcApiHandler** list,
+    BINDER_NFC_EVENT event,
+    GCallback func,
+    gpointer user_data)
+{
+    BinderNfcApiPriv* priv = self->priv;
+    BinderNfcApiHandler* handler = g_slice_new(BinderNfcApiHandler);
+    BinderNfcApiHandler** ptr = list;
+
+    if (!++priv->last_handler_id) {
+        priv->last_handler_id++;
+    }
+    handler->next = NULL;
+    handler->id = priv->last_handler_id;
+    handler->event = event;
+    handler->func = func;
+    handler->user_data = user_data;
+
+    /* Handlers are invoked in the order they were added */
+    while (*ptr) {
+        ptr = &(*ptr)->next;
+    }
+    *ptr = handler;
+    return handler->id;
+}
+
+static
+gboolean
+binder_nfc_api_handler_remove(
+    BinderNfcApi* self,
+    BinderNfcApiHandler** list,
+    gulong id)
+{
+    BinderNfcApiPriv* priv = self->priv;
+    BinderNfcApiHandler** ptr = list;
+
+    while (*ptr) {
+        BinderNfcApiHandler* handler = *ptr;
+
+        if (handler->id == id) {
+            if (priv->dispatching) {
+                /* Can't unlink it right now */
+                handler->func = NULL;
+                priv->handlers_removed = TRUE;
+            } else {
+                *ptr = handler->next;
+                gutil_slice_free(handler);
+            }
+            return TRUE;
+        }
+        ptr = &handler->next;
+    }
+    return FALSE;
+}
+
+static
+void
+binder_nfc_api_handler_cleanup(
+    BinderNfcApiHandler** list)
+{
+    BinderNfcApiHandler** ptr = list;
+
+    while (*ptr) {
+        BinderNfcApiHandler* handler = *ptr;
+
+        if (handler->func) {
+            ptr = &handler->next;
+        } else {
+            *ptr = handler->next;
+            gutil_slice_free(handler);
+        }
+    }
+}
+
+static
+void
+binder_nfc_api_handler_free_all(
+    BinderNfcApiHandler** list)
+{
+    while (*list) {
+        BinderNfcApiHandler* handler = *list;
+
+        *list = handler->next;
+        gutil_slice_free(handler);
+    }
+}
+
+static
+void
+binder_nfc_api_dispatch_begin(
+    BinderNfcApi* self)
+{
+    /* Handlers may drop the last reference */
+    g_object_ref(self);
+    self->priv->dispatching++;
+}
+
+static
+void
+binder_nfc_api_dispatch_end(
+    BinderNfcApi* self)
+{
+    BinderNfcApiPriv* priv = self->priv;
+
+    if (!--priv->dispatching && priv->handlers_removed) {
+        priv->handlers_removed = FALSE;
+        binder_nfc_api_handler_cleanup(&priv->event_handlers);
+        binder_nfc_api_handler_cleanup(&priv->data_handlers);
+    }
+    g_object_unref(self);
 }
 
 /*==========================================================================*
@@ -147,6 +336,7 @@ binder_nfc_api_open(
             user_data);
 
         if (id) {
+            self->priv->callback_active = TRUE;
             return id;
         }
     }
@@ -156,13 +346,14 @@ binder_nfc_api_open(
 gulong
 binder_nfc_api_close(
     BinderNfcApi* self,
+    BINDER_NFC_CLOSE_TYPE type,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
     if (G_LIKELY(self)) {
-        gulong id = GET_THIS_CLASS(self)->close(self, complete, destroy,
-            user_data);
+        gulong id = GET_THIS_CLASS(self)->close(self, type, complete,
+            destroy, user_data);
 
         if (id) {
             return id;
@@ -208,16 +399,14 @@ binder_nfc_api_prediscover(
 }
 
 gulong
-binder_nfc_api_write(
+binder_nfc_api_power_cycle(
     BinderNfcApi* self,
-    const void* data,
-    gsize len,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
     if (G_LIKELY(self)) {
-        gulong id = GET_THIS_CLASS(self)->write(self, data, len, complete,
+        gulong id = GET_THIS_CLASS(self)->power_cycle(self, complete,
             destroy, user_data);
 
         if (id) {
@@ -227,6 +416,26 @@ binder_nfc_api_write(
     return binder_nfc_api_fail(self, destroy, user_data);
 }
 
+gulong
+binder_nfc_api_write(
+    BinderNfcApi* self,
+    const GUtilData* chunks,
+    guint count,
+    BinderNfcApiCompleteFunc complete,
+    GDestroyNotify destroy,
+    gpointer user_data)
+{
+    if (G_LIKELY(self)) {
+        gulong id = GET_THIS_CLASS(self)->write(self, chunks, count,
+            complete, destroy, user_data);
+
+        if (id) {
+            return id;
+        }
+    }
+    return binder_nfc_api_fail(self, destroy, user_data);
+}
+
 gulong
 binder_nfc_api_add_event_handler(
     BinderNfcApi* self,
@@ -235,9 +444,8 @@ binder_nfc_api_add_event_handler(
     void* user_data)
 {
     return (G_LIKELY(self) && G_LIKELY(func)) ?
-        g_signal_connect_closure_by_id(self,
-            binder_nfc_api_signals[SIGNAL_EVENT], event,
-            g_cclosure_new(G_CALLBACK(func), user_data, NULL), FALSE) : 0;
+        binder_nfc_api_handler_add(self, &self->priv->event_handlers,
+            event, G_CALLBACK(func), user_data) : 0;
 }
 
 gulong
@@ -246,8 +454,97 @@ binder_nfc_api_add_data_handler(
     BinderNfcApiDataFunc func,
     void* user_data)
 {
-    return (G_LIKELY(self) && G_LIKELY(func)) ? g_signal_connect(self,
-        SIGNAL_DATA_NAME, G_CALLBACK(func), user_data) : 0;
+    return (G_LIKELY(self) && G_LIKELY(func)) ?
+        binder_nfc_api_handler_add(self, &self->priv->data_handlers,
+            BINDER_NFC_EVENT_ANY, G_CALLBACK(func), user_data) : 0;
+}
+
+void
+binder_nfc_api_remove_handler(
+    BinderNfcApi* self,
+    gulong id)
+{
+    if (G_LIKELY(self) && G_LIKELY(id)) {
+        BinderNfcApiPriv* priv = self->priv;
+
+        if (!binder_nfc_api_handler_remove(self, &priv->data_handlers, id)) {
+            binder_nfc_api_handler_remove(self, &priv->event_handlers, id);
+        }
+    }
+}
+
+void
+binder_nfc_api_set_keep_callback(
+    BinderNfcApi* self,
+    gboolean keep)
+{
+    if (G_LIKELY(self)) {
+        self->priv->keep_callback = keep;
+    }
+}
+
+void
+binder_nfc_api_dump_stats(
+    BinderNfcApi* self,
+    const char* name)
+{
+    static const char* call_names[] = {
+        "open", "close", "coreInitialized", "prediscover", "write",
+        "powerCycle"
+    };
+
+    G_STATIC_ASSERT(G_N_ELEMENTS(call_names) == BINDER_NFC_API_CALL_COUNT);
+    if (G_LIKELY(self)) {
+        BinderNfcApiPriv* priv = self->priv;
+        guint i;
+
+        for (i = 0; i < BINDER_NFC_API_CALL_COUNT; i++) {
+            const BinderNfcApiCallStats* stats = priv->stats + i;
+            const BinderNfcHistogram* ok = &stats->ok;
+            const BinderNfcHistogram* failed = &stats->failed;
+
+            if (ok->count || failed->count || stats->cancelled) {
+                GINFO("%s %s: %u ok, avg %" G_GINT64_FORMAT " p50 %"
+                    G_GINT64_FORMAT " p99 %" G_GINT64_FORMAT " max %"
+                    G_GINT64_FORMAT " us; %u failed, max %" G_GINT64_FORMAT
+                    " us; %u cancelled", name, call_names[i], ok->count,
+                    binder_nfc_histogram_average(ok),
+                    binder_nfc_histogram_percentile(ok, 500),
+                    binder_nfc_histogram_percentile(ok, 990),
+                    ok->max, failed->count, failed->max, stats->cancelled);
+            }
+        }
+        GINFO("%s call pool: %u allocated", name, priv->calls_allocated);
+        if (priv->late_callbacks) {
+            GINFO("%s: %u late callback(s) dropped", name,
+                priv->late_callbacks);
+        }
+    }
+}
+
+gboolean
+binder_nfc_api_power_cycle_unsupported(
+    BinderNfcApi* self)
+{
+    return G_LIKELY(self) && (self->priv->unsupported &
+        (1 << BINDER_NFC_API_CALL_POWER_CYCLE)) != 0;
+}
+
+void
+binder_nfc_api_take_stats(
+    BinderNfcApi* self,
+    BinderNfcApi* from)
+{
+    /* Statistics survive reconnects to a restarted HAL */
+    if (G_LIKELY(self) && G_LIKELY(from) && self != from) {
+        BinderNfcApiPriv* priv = self->priv;
+        BinderNfcApiPriv* src = from->priv;
+
+        memcpy(priv->stats, src->stats, sizeof(priv->stats));
+        priv->late_callbacks = src->late_callbacks;
+        memset(src->stats, 0, sizeof(src->stats));
+        src->late_callbacks = 0;
+    }
 }
 
 /*==========================================================================*
@@ -264,12 +561,53 @@ binder_nfc_api_init_base(
     self->remote = gbinder_remote_object_ref(remote);
 }
 
+gboolean
+binder_nfc_api_keep_callback(
+    BinderNfcApi* self)
+{
+    return self->priv->keep_callback;
+}
+
+void
+binder_nfc_api_callback_closed(
+    BinderNfcApi* self)
+{
+    self->priv->callback_active = FALSE;
+}
+
+gboolean
+binder_nfc_api_callback_check(
+    BinderNfcApi* self)
+{
+    BinderNfcApiPriv* priv = self->priv;
+
+    if (G_LIKELY(priv->callback_active)) {
+        return TRUE;
+    } else {
+        /* HAL is still talking to us after close */
+        GDEBUG("Dropping late callback");
+        priv->late_callbacks++;
+        return FALSE;
+    }
+}
+
 void
 binder_nfc_api_emit_event(
     BinderNfcApi* self,
     BINDER_NFC_EVENT event)
 {
-    g_signal_emit(self, binder_nfc_api_signals[SIGNAL_EVENT], event, event);
+    BinderNfcApiHandler* handler;
+
+    binder_nfc_api_dispatch_begin(self);
+    for (handler = self->priv->event_handlers; handler;
+        handler = handler->next) {
+        if (handler->func && (handler->event == BINDER_NFC_EVENT_ANY ||
+            handler->event == event)) {
+            ((BinderNfcApiEventFunc)handler->func)(self, event,
+                handler->user_data);
+        }
+    }
+    binder_nfc_api_dispatch_end(self);
 }
 
 void
@@ -278,7 +616,17 @@ binder_nfc_api_emit_data(
     const void* data,
     gsize size)
 {
-    g_signal_emit(self, binder_nfc_api_signals[SIGNAL_DATA], 0, data, size);
+    BinderNfcApiHandler* handler;
+
+    binder_nfc_api_dispatch_begin(self);
+    for (handler = self->priv->data_handlers; handler;
+        handler = handler->next) {
+        if (handler->func) {
+            ((BinderNfcApiDataFunc)handler->func)(self, data, size,
+                handler->user_data);
+        }
+    }
+    binder_nfc_api_dispatch_end(self);
 }
 
 /*==========================================================================*
@@ -296,12 +644,24 @@ binder_nfc_api_not_implemented(
     return 0;
 }
 
+static
+gulong
+binder_nfc_api_close_not_implemented(
+    BinderNfcApi* self,
+    BINDER_NFC_CLOSE_TYPE type,
+    BinderNfcApiCompleteFunc complete,
+    GDestroyNotify destroy,
+    gpointer user_data)
+{
+    return 0;
+}
+
 static
 gulong
 binder_nfc_api_write_not_implemented(
     BinderNfcApi* self,
-    const void* data,
-    gsize len,
+    const GUtilData* chunks,
+    guint count,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
@@ -318,6 +678,7 @@ void
 binder_nfc_api_init(
     BinderNfcApi* self)
 {
+    self->priv = binder_nfc_api_get_instance_private(self);
 }
 
 static
@@ -326,7 +687,16 @@ binder_nfc_api_finalize(
     GObject* object)
 {
     BinderNfcApi* self = THIS(object);
+    BinderNfcApiPriv* priv = self->priv;
 
+    while (priv->free_calls) {
+        BinderNfcApiCallImpl* impl = priv->free_calls;
+
+        priv->free_calls = impl->next;
+        gutil_slice_free(impl);
+    }
+    binder_nfc_api_handler_free_all(&priv->event_handlers);
+    binder_nfc_api_handler_free_all(&priv->data_handlers);
     gbinder_client_unref(self->client);
     gbinder_remote_object_unref(self->remote);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
@@ -337,23 +707,13 @@ void
 binder_nfc_api_class_init(
     BinderNfcApiClass* klass)
 {
-    GType type = G_OBJECT_CLASS_TYPE(klass);
-
     klass->open = binder_nfc_api_not_implemented;
-    klass->close = binder_nfc_api_not_implemented;
+    klass->close = binder_nfc_api_close_not_implemented;
     klass->core_initialized = binder_nfc_api_not_implemented;
+    klass->power_cycle = binder_nfc_api_not_implemented;
     klass->prediscover = binder_nfc_api_not_implemented;
     klass->write = binder_nfc_api_write_not_implemented;
     G_OBJECT_CLASS(klass)->finalize = binder_nfc_api_finalize;
-
-    binder_nfc_api_signals[SIGNAL_EVENT] =
-        g_signal_new(SIGNAL_EVENT_NAME, type,
-            G_SIGNAL_RUN_FIRST | G_SIGNAL_DETAILED, 0, NULL, NULL, NULL,
-            G_TYPE_NONE, 1, G_TYPE_INT);
-    binder_nfc_api_signals[SIGNAL_DATA] =
-        g_signal_new(SIGNAL_DATA_NAME, type,
-            G_SIGNAL_RUN_FIRST, 0, NULL, NULL, NULL,
-            G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_ULONG);
 }
 
 /*
@@ -41,12 +41,17 @@
 
 #include "binder_nfc_types.h"
 
+#include <gutil_types.h>
+
 #include <glib-object.h>
 
 /* Abstract binder NFC API */
 
+typedef struct binder_nfc_api_priv BinderNfcApiPriv;
+
 struct binder_nfc_api {
     GObject object;
+    BinderNfcApiPriv* priv;
     GBinderClient* client;
     GBinderRemoteObject* remote;
 };
@@ -54,9 +59,18 @@ struct binder_nfc_api {
 typedef enum binder_nfc_event {
     BINDER_NFC_EVENT_ANY,
     BINDER_NFC_EVENT_OPEN_CPLT,
-    BINDER_NFC_EVENT_CLOSE_CPLT
+    BINDER_NFC_EVENT_CLOSE_CPLT,
+    BINDER_NFC_EVENT_POST_INIT_CPLT,
+    BINDER_NFC_EVENT_PRE_DISCOVER_CPLT,
+    BINDER_NFC_EVENT_HCI_NETWORK_RESET,
+    BINDER_NFC_EVENT_ERROR
 } BINDER_NFC_EVENT;
 
+typedef enum binder_nfc_close_type {
+    BINDER_NFC_CLOSE_DISABLE,           /* NFC is being switched off */
+    BINDER_NFC_CLOSE_HOST_SWITCHED_OFF  /* Controller stays in low power */
+} BINDER_NFC_CLOSE_TYPE;
+
 typedef
 void
 (*BinderNfcApiCompleteFunc)(
@@ -90,6 +104,7 @@ binder_nfc_api_open(
 gulong
 binder_nfc_api_close(
     BinderNfcApi* api,
+    BINDER_NFC_CLOSE_TYPE type,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
@@ -111,11 +126,19 @@ binder_nfc_api_prediscover(
     gpointer user_data)
     G_GNUC_INTERNAL;
 
+gulong
+binder_nfc_api_power_cycle(
+    BinderNfcApi* api,
+    BinderNfcApiCompleteFunc complete,
+    GDestroyNotify destroy,
+    gpointer user_data)
+    G_GNUC_INTERNAL;
+
 gulong
 binder_nfc_api_write(
     BinderNfcApi* api,
-    const void* data,
-    gsize len,
+    const GUtilData* chunks,
+    guint count,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
@@ -136,6 +159,35 @@ binder_nfc_api_add_data_handler(
     void* user_data)
     G_GNUC_INTERNAL;
 
+void
+binder_nfc_api_remove_handler(
+    BinderNfcApi* api,
+    gulong id)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_api_set_keep_callback(
+    BinderNfcApi* api,
+    gboolean keep)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_api_dump_stats(
+    BinderNfcApi* api,
+    const char* name)
+    G_GNUC_INTERNAL;
+
+gboolean
+binder_nfc_api_power_cycle_unsupported(
+    BinderNfcApi* api)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_api_take_stats(
+    BinderNfcApi* api,
+    BinderNfcApi* from)
+    G_GNUC_INTERNAL;
+
 #endif /* BINDER_NFC_API_H */
 
 /*
@@ -38,12 +38,16 @@
 
 #include "binder_nfc_api_aidl.h"
 #include "binder_nfc_api_impl.h"
+#include "binder_nfc_trace.h"
 
 #include <gbinder.h>
 
 typedef struct binder_nfc_api_aidl {
     BinderNfcApi parent;
     GBinderLocalObject* callback;
+    GBinderLocalRequest* open_req;  /* Goes together with the callback */
+    GBinderLocalRequest* close_req;
+    GBinderLocalRequest* close_off_req;
 } BinderNfcApiAidl;
 
 typedef BinderNfcApiClass BinderNfcApiAidlClass;
@@ -84,6 +88,9 @@ enum binder_nfc_aidl_close_type {
     BINDER_NFC_AIDL_CLOSE_HOST_SWITCHED_OFF
 };
 
+/* Binder exception code of a method the service doesn't implement */
+#define BINDER_NFC_AIDL_EX_UNSUPPORTED_OPERATION (-7)
+
 #define BINDER_NFC_AIDL_EVENTS(e) \
     e(OPEN_CPLT) \
     e(CLOSE_CPLT) \
@@ -114,6 +121,14 @@ binder_nfc_api_aidl_new(
 
     binder_nfc_api_init_base(api, client, remote);
     gbinder_client_unref(client);
+
+    /* Close requests never change */
+    self->close_req = gbinder_client_new_request(api->client);
+    gbinder_local_request_append_int32(self->close_req,
+        BINDER_NFC_AIDL_CLOSE_DISABLE);
+    self->close_off_req = gbinder_client_new_request(api->client);
+    gbinder_local_request_append_int32(self->close_off_req,
+        BINDER_NFC_AIDL_CLOSE_HOST_SWITCHED_OFF);
     return api;
 }
 
@@ -134,6 +149,7 @@ binder_nfc_api_aidl_handle_event(
         gbinder_reader_at_end(reader)) {
         BinderNfcApi* api = &self->parent;
 
+        BINDER_TRACE2(hal_event, event, status);
 #if GUTIL_LOG_DEBUG
         if (GLOG_ENABLED(GLOG_LEVEL_DEBUG)) {
             switch (event) {
@@ -155,6 +171,20 @@ binder_nfc_api_aidl_handle_event(
         case NFC_AIDL_EVT_CLOSE_CPLT:
             binder_nfc_api_emit_event(api, BINDER_NFC_EVENT_CLOSE_CPLT);
             break;
+        case NFC_AIDL_EVT_POST_INIT_CPLT:
+            binder_nfc_api_emit_event(api, BINDER_NFC_EVENT_POST_INIT_CPLT);
+            break;
+        case NFC_AIDL_EVT_PRE_DISCOVER_CPLT:
+            binder_nfc_api_emit_event(api,
+                BINDER_NFC_EVENT_PRE_DISCOVER_CPLT);
+            break;
+        case NFC_AIDL_EVT_HCI_NETWORK_RESET:
+            binder_nfc_api_emit_event(api,
+                BINDER_NFC_EVENT_HCI_NETWORK_RESET);
+            break;
+        case NFC_AIDL_EVT_ERROR:
+            binder_nfc_api_emit_event(api, BINDER_NFC_EVENT_ERROR);
+            break;
         default:
             break;
         }
@@ -175,6 +205,7 @@ binder_nfc_api_aidl_handle_data(
     const guint8* data = gbinder_reader_read_byte_array(reader, &len);
 
     if (data && gbinder_reader_at_end(reader)) {
+        BINDER_TRACE1(hal_data, len);
         binder_nfc_api_emit_data(&self->parent, data, len);
         return GBINDER_STATUS_OK;
     } else {
@@ -196,7 +227,10 @@ binder_nfc_api_aidl_callback_handler(
     BinderNfcApiAidl* self = THIS(user_data);
     const char* iface = gbinder_remote_request_interface(req);
 
-    if (!g_strcmp0(iface, BINDER_NFC_AIDL_CALLBACK_IFACE)) {
+    if (!binder_nfc_api_callback_check(&self->parent)) {
+        /* Too late, just ack it */
+        *status = GBINDER_STATUS_OK;
+    } else if (!g_strcmp0(iface, BINDER_NFC_AIDL_CALLBACK_IFACE)) {
         GBinderReader reader;
 
         gbinder_remote_request_init_reader(req, &reader);
@@ -232,11 +266,17 @@ binder_nfc_api_aidl_complete(
 {
     int result = -1;
 
-    /* Generic completion */
-    binder_nfc_api_call_complete(call,
-        status == GBINDER_STATUS_OK &&
-        gbinder_remote_reply_read_int32(reply, &result) &&
-        result == 0);
+    /* Generic completion, the result is the exception code */
+    if (status == BINDER_NFC_UNKNOWN_TRANSACTION) {
+        binder_nfc_api_call_unsupported(call);
+    } else if (status != GBINDER_STATUS_OK ||
+        !gbinder_remote_reply_read_int32(reply, &result)) {
+        binder_nfc_api_call_complete(call, FALSE);
+    } else if (result == BINDER_NFC_AIDL_EX_UNSUPPORTED_OPERATION) {
+        binder_nfc_api_call_unsupported(call);
+    } else {
+        binder_nfc_api_call_complete(call, result == 0);
+    }
 }
 
 static
@@ -244,6 +284,7 @@ gulong
 binder_nfc_api_aidl_call(
     BinderNfcApi* api,
     BINDER_NFC_AIDL_REQ code,
+    BINDER_NFC_API_CALL_TYPE type,
     GBinderLocalRequest* req,  /* gets unref'd */
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
@@ -251,7 +292,7 @@ binder_nfc_api_aidl_call(
 {
     gulong id = gbinder_client_transact(api->client, code, 0, req,
         binder_nfc_api_aidl_complete, binder_nfc_api_call_destroy,
-        binder_nfc_api_call_new(api, complete, destroy, user_data));
+        binder_nfc_api_call_new(api, type, complete, destroy, user_data));
 
     gbinder_local_request_unref(req);
     return id;
@@ -268,9 +309,14 @@ binder_nfc_api_aidl_close_complete(
     BinderNfcApiCall* call = user_data;
     BinderNfcApiAidl* self = THIS(call->api);
 
-    /* We can release our local object now */
-    gbinder_local_object_drop(self->callback);
-    self->callback = NULL;
+    /* We can release our local object now, unless we are keeping it */
+    binder_nfc_api_callback_closed(call->api);
+    if (!binder_nfc_api_keep_callback(call->api)) {
+        gbinder_local_request_unref(self->open_req);
+        gbinder_local_object_drop(self->callback);
+        self->open_req = NULL;
+        self->callback = NULL;
+    }
     binder_nfc_api_aidl_complete(client, reply, status, call);
 }
 
@@ -287,8 +333,8 @@ binder_nfc_api_aidl_open(
     gpointer user_data)
 {
     BinderNfcApiAidl* self = THIS(api);
-    GBinderLocalRequest* req = gbinder_client_new_request(api->client);
 
+    /* The same request is reused until the callback object is dropped */
     if (!self->callback) {
         GBinderIpc* ipc = gbinder_remote_object_ipc(api->remote);
         static const char* ifaces[] = { BINDER_NFC_AIDL_CALLBACK_IFACE, NULL };
@@ -297,13 +343,15 @@ binder_nfc_api_aidl_open(
             binder_nfc_api_aidl_callback_handler, self);
         gbinder_local_object_set_stability(self->callback,
             GBINDER_STABILITY_VINTF);
+        self->open_req = gbinder_client_new_request(api->client);
+        gbinder_local_request_append_local_object(self->open_req,
+            self->callback);
     }
 
-    gbinder_local_request_append_local_object(req, self->callback);
-
     /* binder_nfc_api_aidl_call unrefs the request */
     return binder_nfc_api_aidl_call(api,
-        BINDER_NFC_AIDL_REQ_OPEN, req,
+        BINDER_NFC_AIDL_REQ_OPEN,
+        BINDER_NFC_API_CALL_OPEN, gbinder_local_request_ref(self->open_req),
         complete, destroy, user_data);
 }
 
@@ -311,21 +359,21 @@ static
 gulong
 binder_nfc_api_aidl_close(
     BinderNfcApi* api,
+    BINDER_NFC_CLOSE_TYPE type,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
-    gulong id;
-    GBinderLocalRequest* req = gbinder_client_new_request(api->client);
+    BinderNfcApiAidl* self = THIS(api);
 
-    gbinder_local_request_append_int32(req, BINDER_NFC_AIDL_CLOSE_DISABLE);
-    id = gbinder_client_transact(api->client,
-        BINDER_NFC_AIDL_REQ_CLOSE, 0, req,
+    return gbinder_client_transact(api->client,
+        BINDER_NFC_AIDL_REQ_CLOSE, 0,
+        (type == BINDER_NFC_CLOSE_HOST_SWITCHED_OFF) ?
+            self->close_off_req : self->close_req,
         binder_nfc_api_aidl_close_complete,
         binder_nfc_api_call_destroy,
-        binder_nfc_api_call_new(api, complete, destroy, user_data));
-    gbinder_local_request_unref(req);
-    return id;
+        binder_nfc_api_call_new(api, BINDER_NFC_API_CALL_CLOSE,
+            complete, destroy, user_data));
 }
 
 static
@@ -337,7 +385,8 @@ binder_nfc_api_aidl_core_initialized(
     gpointer user_data)
 {
     return binder_nfc_api_aidl_call(api,
-        BINDER_NFC_AIDL_REQ_CORE_INITIALIZED, NULL,
+        BINDER_NFC_AIDL_REQ_CORE_INITIALIZED,
+        BINDER_NFC_API_CALL_CORE_INITIALIZED, NULL,
         complete, destroy, user_data);
 }
 
@@ -350,7 +399,22 @@ binder_nfc_api_aidl_prediscover(
     gpointer user_data)
 {
     return binder_nfc_api_aidl_call(api,
-        BINDER_NFC_AIDL_REQ_PREDISCOVER, NULL,
+        BINDER_NFC_AIDL_REQ_PREDISCOVER,
+        BINDER_NFC_API_CALL_PREDISCOVER, NULL,
+        complete, destroy, user_data);
+}
+
+static
+gulong
+binder_nfc_api_aidl_power_cycle(
+    BinderNfcApi* api,
+    BinderNfcApiCompleteFunc complete,
+    GDestroyNotify destroy,
+    gpointer user_data)
+{
+    return binder_nfc_api_aidl_call(api,
+        BINDER_NFC_AIDL_REQ_POWER_CYCLE,
+        BINDER_NFC_API_CALL_POWER_CYCLE, NULL,
         complete, destroy, user_data);
 }
 
@@ -358,21 +422,41 @@ static
 gulong
 binder_nfc_api_aidl_write(
     BinderNfcApi* api,
-    const void* data,
-    gsize len,
+    const GUtilData* chunks,
+    guint count,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
     GBinderLocalRequest* req = gbinder_client_new_request(api->client);
     GBinderWriter writer;
+    gsize len = 0;
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        len += chunks[i].size;
+    }
 
+    /*
+     * Same thing as gbinder_writer_append_byte_array() does but without
+     * having to concatenate the chunks first. The byte array is padded
+     * to 4 bytes.
+     */
     gbinder_local_request_init_writer(req, &writer);
-    gbinder_writer_append_byte_array(&writer, data, len);
+    gbinder_writer_append_int32(&writer, len);
+    for (i = 0; i < count; i++) {
+        gbinder_writer_append_bytes(&writer, chunks[i].bytes, chunks[i].size);
+    }
+    if (len % 4) {
+        static const guint8 pad[4] = { 0 };
+
+        gbinder_writer_append_bytes(&writer, pad, 4 - (len % 4));
+    }
 
     /* binder_nfc_api_aidl_call unrefs the request */
     return binder_nfc_api_aidl_call(api,
-        BINDER_NFC_AIDL_REQ_WRITE, req,
+        BINDER_NFC_AIDL_REQ_WRITE,
+        BINDER_NFC_API_CALL_WRITE, req,
         complete, destroy, user_data);
 }
 
@@ -394,6 +478,9 @@ binder_nfc_api_aidl_finalize(
 {
     BinderNfcApiAidl* self = THIS(object);
 
+    gbinder_local_request_unref(self->open_req);
+    gbinder_local_request_unref(self->close_req);
+    gbinder_local_request_unref(self->close_off_req);
     gbinder_local_object_drop(self->callback);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
@@ -409,6 +496,7 @@ binder_nfc_api_aidl_class_init(
     client->close = binder_nfc_api_aidl_close;
     client->core_initialized = binder_nfc_api_aidl_core_initialized;
     client->prediscover = binder_nfc_api_aidl_prediscover;
+    client->power_cycle = binder_nfc_api_aidl_power_cycle;
     client->write = binder_nfc_api_aidl_write;
     G_OBJECT_CLASS(klass)->finalize = binder_nfc_api_aidl_finalize;
 }
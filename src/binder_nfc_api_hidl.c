@@ -38,13 +38,17 @@
 
 #include "binder_nfc_api_hidl.h"
 #include "binder_nfc_api_impl.h"
+#include "binder_nfc_trace.h"
 
 #include <gbinder.h>
 
+#include <string.h>
+
 typedef BinderNfcApiClass BinderNfcApiHidlClass;
 typedef struct binder_nfc_api_hidl {
     BinderNfcApi parent;
     GBinderLocalObject* callback;
+    GBinderLocalRequest* open_req;  /* Goes together with the callback */
 } BinderNfcApiHidl;
 
 #define PARENT_CLASS binder_nfc_api_hidl_parent_class
@@ -63,9 +67,14 @@ typedef enum binder_nfc_hidl_req {
     BINDER_NFC_HIDL_REQ_PREDISCOVER,       /* prediscover */
     BINDER_NFC_HIDL_REQ_CLOSE,             /* close */
     BINDER_NFC_HIDL_REQ_CONTROL_GRANTED,   /* controlGranted */
-    BINDER_NFC_HIDL_REQ_POWER_CYCLE        /* powerCycle */
+    BINDER_NFC_HIDL_REQ_POWER_CYCLE,       /* powerCycle */
+    /* android.hardware.nfc@1.1::INfc */
+    BINDER_NFC_HIDL_REQ_FACTORY_RESET,     /* factoryReset */
+    BINDER_NFC_HIDL_REQ_CLOSE_FOR_POWER_OFF_CASE /* closeForPowerOffCase */
 } BINDER_NFC_HIDL_REQ;
 
+#define BINDER_NFC_HIDL_IFACE_1_1 "android.hardware.nfc@1.1::INfc"
+
 /* android.hardware.nfc@1.0::INfcClientCallback */
 #define BINDER_NFC_HIDL_CALLBACK_IFACE \
     BINDER_NFC_HIDL_IFACE_("INfcClientCallback")
@@ -83,6 +92,12 @@ typedef enum binder_nfc_hidl_callback_req {
     e(RELEASE_CONTROL) \
     e(ERROR)
 
+/*
+ * HCI_NETWORK_RESET is only sent by 1.1 HALs through sendEvent_1_1 to
+ * the 1.1 callback registered by open_1_1. We register the 1.0 callback,
+ * so it never comes here.
+ */
+
 enum binder_nfc_api_hidl_event {
     #define NFC_HIDL_EVT(x) NFC_HIDL_EVT_##x,
     BINDER_NFC_HIDL_EVENTS(NFC_HIDL_EVT)
@@ -97,9 +112,16 @@ BinderNfcApi*
 binder_nfc_api_hidl_new(
     GBinderRemoteObject* remote)
 {
+    /* 1.1 methods are sent with 1.1 interface token, the rest with 1.0 */
+    static const GBinderClientIfaceInfo ifaces[] = {
+        { BINDER_NFC_HIDL_IFACE_1_1,
+          BINDER_NFC_HIDL_REQ_CLOSE_FOR_POWER_OFF_CASE },
+        { BINDER_NFC_HIDL_IFACE, BINDER_NFC_HIDL_REQ_POWER_CYCLE }
+    };
     BinderNfcApiHidl* self = g_object_new(THIS_TYPE, NULL);
     BinderNfcApi* api = &self->parent;
-    GBinderClient* client = gbinder_client_new(remote, BINDER_NFC_HIDL_IFACE);
+    GBinderClient* client = gbinder_client_new2(remote, ifaces,
+        G_N_ELEMENTS(ifaces));
 
     binder_nfc_api_init_base(api, client, remote);
     gbinder_client_unref(client);
@@ -123,6 +145,7 @@ binder_nfc_api_hidl_handle_event(
         gbinder_reader_at_end(reader)) {
         BinderNfcApi* api = &self->parent;
 
+        BINDER_TRACE2(hal_event, event, status);
 #if GUTIL_LOG_DEBUG
         if (GLOG_ENABLED(GLOG_LEVEL_DEBUG)) {
             switch (event) {
@@ -144,6 +167,16 @@ binder_nfc_api_hidl_handle_event(
         case NFC_HIDL_EVT_CLOSE_CPLT:
             binder_nfc_api_emit_event(api, BINDER_NFC_EVENT_CLOSE_CPLT);
             break;
+        case NFC_HIDL_EVT_POST_INIT_CPLT:
+            binder_nfc_api_emit_event(api, BINDER_NFC_EVENT_POST_INIT_CPLT);
+            break;
+        case NFC_HIDL_EVT_PRE_DISCOVER_CPLT:
+            binder_nfc_api_emit_event(api,
+                BINDER_NFC_EVENT_PRE_DISCOVER_CPLT);
+            break;
+        case NFC_HIDL_EVT_ERROR:
+            binder_nfc_api_emit_event(api, BINDER_NFC_EVENT_ERROR);
+            break;
         default:
             break;
         }
@@ -164,6 +197,7 @@ binder_nfc_api_hidl_handle_data(
     const guint8* data = gbinder_reader_read_hidl_byte_vec(reader, &len);
 
     if (data && gbinder_reader_at_end(reader)) {
+        BINDER_TRACE1(hal_data, len);
         binder_nfc_api_emit_data(&self->parent, data, len);
         return GBINDER_STATUS_OK;
     } else {
@@ -185,7 +219,10 @@ binder_nfc_api_hidl_callback_handler(
     BinderNfcApiHidl* self = THIS(user_data);
     const char* iface = gbinder_remote_request_interface(req);
 
-    if (!g_strcmp0(iface, BINDER_NFC_HIDL_CALLBACK_IFACE)) {
+    if (!binder_nfc_api_callback_check(&self->parent)) {
+        /* Too late, just ack it */
+        *status = GBINDER_STATUS_OK;
+    } else if (!g_strcmp0(iface, BINDER_NFC_HIDL_CALLBACK_IFACE)) {
         GBinderReader reader;
 
         gbinder_remote_request_init_reader(req, &reader);
@@ -222,10 +259,14 @@ binder_nfc_api_hidl_complete(
     int result = -1;
 
     /* Generic completion */
-    binder_nfc_api_call_complete(call,
-        status == GBINDER_STATUS_OK &&
-        gbinder_remote_reply_read_int32(reply, &result) &&
-        result == 0);
+    if (status == BINDER_NFC_UNKNOWN_TRANSACTION) {
+        binder_nfc_api_call_unsupported(call);
+    } else {
+        binder_nfc_api_call_complete(call,
+            status == GBINDER_STATUS_OK &&
+            gbinder_remote_reply_read_int32(reply, &result) &&
+            result == 0);
+    }
 }
 
 static
@@ -233,6 +274,7 @@ gulong
 binder_nfc_api_hidl_call(
     BinderNfcApi* api,
     BINDER_NFC_HIDL_REQ code,
+    BINDER_NFC_API_CALL_TYPE type,
     GBinderLocalRequest* req,  /* gets unref'd */
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
@@ -240,7 +282,7 @@ binder_nfc_api_hidl_call(
 {
     gulong id = gbinder_client_transact(api->client, code, 0, req,
         binder_nfc_api_hidl_complete, binder_nfc_api_call_destroy,
-        binder_nfc_api_call_new(api, complete, destroy, user_data));
+        binder_nfc_api_call_new(api, type, complete, destroy, user_data));
 
     gbinder_local_request_unref(req);
     return id;
@@ -257,9 +299,14 @@ binder_nfc_api_hidl_close_complete(
     BinderNfcApiCall* call = user_data;
     BinderNfcApiHidl* self = THIS(call->api);
 
-    /* We can release our local object now */
-    gbinder_local_object_drop(self->callback);
-    self->callback = NULL;
+    /* We can release our local object now, unless we are keeping it */
+    binder_nfc_api_callback_closed(call->api);
+    if (!binder_nfc_api_keep_callback(call->api)) {
+        gbinder_local_request_unref(self->open_req);
+        gbinder_local_object_drop(self->callback);
+        self->open_req = NULL;
+        self->callback = NULL;
+    }
     binder_nfc_api_hidl_complete(client, reply, status, call);
 }
 
@@ -276,21 +323,23 @@ binder_nfc_api_hidl_open(
     gpointer user_data)
 {
     BinderNfcApiHidl* self = THIS(api);
-    GBinderLocalRequest* req = gbinder_client_new_request(api->client);
 
+    /* The same request is reused until the callback object is dropped */
     if (!self->callback) {
         GBinderIpc* ipc = gbinder_remote_object_ipc(api->remote);
         static const char* ifaces[] = { BINDER_NFC_HIDL_CALLBACK_IFACE, NULL };
 
         self->callback = gbinder_local_object_new(ipc, ifaces,
             binder_nfc_api_hidl_callback_handler, self);
+        self->open_req = gbinder_client_new_request(api->client);
+        gbinder_local_request_append_local_object(self->open_req,
+            self->callback);
     }
 
-    gbinder_local_request_append_local_object(req, self->callback);
-
     /* binder_nfc_api_hidl_call unrefs the request */
     return binder_nfc_api_hidl_call(api,
-        BINDER_NFC_HIDL_REQ_OPEN, req,
+        BINDER_NFC_HIDL_REQ_OPEN,
+        BINDER_NFC_API_CALL_OPEN, gbinder_local_request_ref(self->open_req),
         complete, destroy, user_data);
 }
 
@@ -298,15 +347,20 @@ static
 gulong
 binder_nfc_api_hidl_close(
     BinderNfcApi* api,
+    BINDER_NFC_CLOSE_TYPE type,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
+    /* closeForPowerOffCase() fails with 1.0 HALs */
     return gbinder_client_transact(api->client,
-        BINDER_NFC_HIDL_REQ_CLOSE, 0, NULL,
+        (type == BINDER_NFC_CLOSE_HOST_SWITCHED_OFF) ?
+            BINDER_NFC_HIDL_REQ_CLOSE_FOR_POWER_OFF_CASE :
+            BINDER_NFC_HIDL_REQ_CLOSE, 0, NULL,
         binder_nfc_api_hidl_close_complete,
         binder_nfc_api_call_destroy,
-        binder_nfc_api_call_new(api, complete, destroy, user_data));
+        binder_nfc_api_call_new(api, BINDER_NFC_API_CALL_CLOSE,
+            complete, destroy, user_data));
 }
 
 static
@@ -318,7 +372,8 @@ binder_nfc_api_hidl_core_initialized(
     gpointer user_data)
 {
     return binder_nfc_api_hidl_call(api,
-        BINDER_NFC_HIDL_REQ_CORE_INITIALIZED, NULL,
+        BINDER_NFC_HIDL_REQ_CORE_INITIALIZED,
+        BINDER_NFC_API_CALL_CORE_INITIALIZED, NULL,
         complete, destroy, user_data);
 }
 
@@ -331,7 +386,22 @@ binder_nfc_api_hidl_prediscover(
     gpointer user_data)
 {
     return binder_nfc_api_hidl_call(api,
-        BINDER_NFC_HIDL_REQ_PREDISCOVER, NULL,
+        BINDER_NFC_HIDL_REQ_PREDISCOVER,
+        BINDER_NFC_API_CALL_PREDISCOVER, NULL,
+        complete, destroy, user_data);
+}
+
+static
+gulong
+binder_nfc_api_hidl_power_cycle(
+    BinderNfcApi* api,
+    BinderNfcApiCompleteFunc complete,
+    GDestroyNotify destroy,
+    gpointer user_data)
+{
+    return binder_nfc_api_hidl_call(api,
+        BINDER_NFC_HIDL_REQ_POWER_CYCLE,
+        BINDER_NFC_API_CALL_POWER_CYCLE, NULL,
         complete, destroy, user_data);
 }
 
@@ -339,21 +409,47 @@ static
 gulong
 binder_nfc_api_hidl_write(
     BinderNfcApi* api,
-    const void* data,
-    gsize len,
+    const GUtilData* chunks,
+    guint count,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
 {
     GBinderLocalRequest* req = gbinder_client_new_request(api->client);
     GBinderWriter writer;
+    GBinderHidlVec* vec;
+    GBinderParent parent;
+    guint8* ptr;
+    gsize len = 0;
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        len += chunks[i].size;
+    }
 
+    /*
+     * Same thing as gbinder_writer_append_hidl_vec() does but the chunks
+     * get copied straight into the buffer owned by the request.
+     */
     gbinder_local_request_init_writer(req, &writer);
-    gbinder_writer_append_hidl_vec(&writer, data, len, 1);
+    vec = gbinder_writer_new0(&writer, GBinderHidlVec);
+    vec->data.ptr = ptr = gbinder_writer_malloc(&writer, len);
+    vec->count = len;
+    vec->owns_buffer = TRUE;
+    for (i = 0; i < count; i++) {
+        memcpy(ptr, chunks[i].bytes, chunks[i].size);
+        ptr += chunks[i].size;
+    }
+    parent.index = gbinder_writer_append_buffer_object(&writer, vec,
+        sizeof(*vec));
+    parent.offset = GBINDER_HIDL_VEC_BUFFER_OFFSET;
+    gbinder_writer_append_buffer_object_with_parent(&writer, vec->data.ptr,
+        len, &parent);
 
     /* binder_nfc_api_hidl_call unrefs the request */
     return binder_nfc_api_hidl_call(api,
-        BINDER_NFC_HIDL_REQ_WRITE, req,
+        BINDER_NFC_HIDL_REQ_WRITE,
+        BINDER_NFC_API_CALL_WRITE, req,
         complete, destroy, user_data);
 }
 
@@ -375,6 +471,7 @@ binder_nfc_api_hidl_finalize(
 {
     BinderNfcApiHidl* self = THIS(object);
 
+    gbinder_local_request_unref(self->open_req);
     gbinder_local_object_drop(self->callback);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
@@ -388,6 +485,7 @@ binder_nfc_api_hidl_class_init(
     klass->close = binder_nfc_api_hidl_close;
     klass->core_initialized = binder_nfc_api_hidl_core_initialized;
     klass->prediscover = binder_nfc_api_hidl_prediscover;
+    klass->power_cycle = binder_nfc_api_hidl_power_cycle;
     klass->write = binder_nfc_api_hidl_write;
     G_OBJECT_CLASS(klass)->finalize = binder_nfc_api_hidl_finalize;
 }
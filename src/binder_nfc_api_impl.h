@@ -41,6 +41,8 @@
 
 #include "binder_nfc_api.h"
 
+#include <errno.h>
+
 typedef
 gulong
 (*BinderNfcApiApiFunc)(
@@ -52,13 +54,19 @@ gulong
 typedef struct binder_nfc_api_class {
     GObjectClass parent;
     BinderNfcApiApiFunc open;
-    BinderNfcApiApiFunc close;
+    gulong (*close)(
+        BinderNfcApi* api,
+        BINDER_NFC_CLOSE_TYPE type,
+        BinderNfcApiCompleteFunc complete,
+        GDestroyNotify destroy,
+        gpointer user_data);
     BinderNfcApiApiFunc core_initialized;
     BinderNfcApiApiFunc prediscover;
+    BinderNfcApiApiFunc power_cycle;
     gulong (*write)(
         BinderNfcApi* api,
-        const void* data,
-        gsize len,
+        const GUtilData* chunks,
+        guint count,
         BinderNfcApiCompleteFunc complete,
         GDestroyNotify destroy,
         gpointer user_data);
@@ -79,6 +87,21 @@ binder_nfc_api_init_base(
     GBinderRemoteObject* remote)
     G_GNUC_INTERNAL;
 
+gboolean
+binder_nfc_api_keep_callback(
+    BinderNfcApi* api)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_api_callback_closed(
+    BinderNfcApi* api)
+    G_GNUC_INTERNAL;
+
+gboolean
+binder_nfc_api_callback_check(
+    BinderNfcApi* api)
+    G_GNUC_INTERNAL;
+
 void
 binder_nfc_api_emit_event(
     BinderNfcApi* api,
@@ -92,6 +115,20 @@ binder_nfc_api_emit_data(
     gsize size)
     G_GNUC_INTERNAL;
 
+/* Transaction status of a call the service doesn't know about */
+#define BINDER_NFC_UNKNOWN_TRANSACTION (-EBADMSG)
+
+/* Transaction types, for statistics */
+typedef enum binder_nfc_api_call_type {
+    BINDER_NFC_API_CALL_OPEN,
+    BINDER_NFC_API_CALL_CLOSE,
+    BINDER_NFC_API_CALL_CORE_INITIALIZED,
+    BINDER_NFC_API_CALL_PREDISCOVER,
+    BINDER_NFC_API_CALL_WRITE,
+    BINDER_NFC_API_CALL_POWER_CYCLE,
+    BINDER_NFC_API_CALL_COUNT
+} BINDER_NFC_API_CALL_TYPE;
+
 typedef struct binder_nfc_api_call {
     BinderNfcApi* api;
 } BinderNfcApiCall;
@@ -99,6 +136,7 @@ typedef struct binder_nfc_api_call {
 BinderNfcApiCall*
 binder_nfc_api_call_new(
     BinderNfcApi* api,
+    BINDER_NFC_API_CALL_TYPE type,
     BinderNfcApiCompleteFunc complete,
     GDestroyNotify destroy,
     gpointer user_data)
@@ -110,6 +148,11 @@ binder_nfc_api_call_complete(
     gboolean ok)
     G_GNUC_INTERNAL;
 
+void
+binder_nfc_api_call_unsupported(
+    BinderNfcApiCall* call)
+    G_GNUC_INTERNAL;
+
 void
 binder_nfc_api_call_destroy(
     gpointer call)
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "binder_nfc_cache.h"
+
+#include <glib/gstdio.h>
+
+#define CACHE_GROUP "Binder"
+#define CACHE_ENTRY_SERVICE "Service"
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+char*
+binder_nfc_cache_get_service(
+    const char* path)
+{
+    GKeyFile* file = g_key_file_new();
+    char* fqname = NULL;
+
+    if (g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, NULL)) {
+        fqname = g_key_file_get_string(file, CACHE_GROUP,
+            CACHE_ENTRY_SERVICE, NULL);
+        if (fqname && !fqname[0]) {
+            g_free(fqname);
+            fqname = NULL;
+        }
+    }
+    g_key_file_unref(file);
+    return fqname;
+}
+
+void
+binder_nfc_cache_set_service(
+    const char* path,
+    const char* fqname)
+{
+    char* cached = binder_nfc_cache_get_service(path);
+
+    if (g_strcmp0(cached, fqname)) {
+        GError* error = NULL;
+
+        if (fqname) {
+            GKeyFile* file = g_key_file_new();
+            char* dir = g_path_get_dirname(path);
+            char* data;
+            gsize size;
+
+            g_key_file_set_string(file, CACHE_GROUP, CACHE_ENTRY_SERVICE,
+                fqname);
+            data = g_key_file_to_data(file, &size, NULL);
+            g_mkdir_with_parents(dir, 0755);
+            if (g_file_set_contents(path, data, size, &error)) {
+                GDEBUG("Cached %s in %s", fqname, path);
+            } else {
+                GWARN("%s", GERRMSG(error));
+                g_error_free(error);
+            }
+            g_free(data);
+            g_free(dir);
+            g_key_file_unref(file);
+        } else if (g_unlink(path) == 0) {
+            GDEBUG("Removed %s", path);
+        }
+    }
+    g_free(cached);
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
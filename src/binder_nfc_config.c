@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "binder_nfc_config.h"
+
+#include <string.h>
+
+#define CONFIG_ENTRY_WRITE_QUEUE "WriteQueue"
+#define CONFIG_ENTRY_CLOSE_DELAY "CloseDelay"
+#define CONFIG_ENTRY_KEEP_CALLBACK "KeepCallback"
+#define CONFIG_ENTRY_HOST_SWITCHED_OFF "HostSwitchedOff"
+#define CONFIG_ENTRY_CALL_TIMEOUT "CallTimeout"
+#define CONFIG_ENTRY_WRITE_TIMEOUT "WriteTimeout"
+#define CONFIG_ENTRY_LOOP_PROBE "LoopProbe"
+#define CONFIG_ENTRY_BATCH_READS "BatchReads"
+#define CONFIG_ENTRY_REASSEMBLE_PACKETS "ReassemblePackets"
+#define CONFIG_ENTRY_DUMP_SIGNAL "DumpSignal"
+#define CONFIG_ENTRY_RT_PRIORITY "RealtimePriority"
+#define CONFIG_ENTRY_NICE "Nice"
+#define CONFIG_ENTRY_CPU_AFFINITY "CpuAffinity"
+#define CONFIG_ENTRY_SERVICE "Service"
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+gboolean
+binder_nfc_config_get_int(
+    GKeyFile* file,
+    const char* key,
+    int* value)
+{
+    GError* error = NULL;
+    int ival = g_key_file_get_integer(file, BINDER_NFC_CONFIG_GROUP, key,
+        &error);
+
+    if (error) {
+        if (error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND &&
+            error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND) {
+            GWARN("%s: %s", key, GERRMSG(error));
+        }
+        g_error_free(error);
+        return FALSE;
+    } else {
+        *value = ival;
+        return TRUE;
+    }
+}
+
+static
+gboolean
+binder_nfc_config_get_boolean(
+    GKeyFile* file,
+    const char* key,
+    gboolean* value)
+{
+    GError* error = NULL;
+    gboolean bval = g_key_file_get_boolean(file, BINDER_NFC_CONFIG_GROUP,
+        key, &error);
+
+    if (error) {
+        if (error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND &&
+            error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND) {
+            GWARN("%s: %s", key, GERRMSG(error));
+        }
+        g_error_free(error);
+        return FALSE;
+    } else {
+        *value = bval;
+        return TRUE;
+    }
+}
+
+static
+gboolean
+binder_nfc_config_get_cpu_mask(
+    GKeyFile* file,
+    const char* key,
+    guint64* value)
+{
+    GError* error = NULL;
+    gsize i, n = 0;
+    int* cpus = g_key_file_get_integer_list(file, BINDER_NFC_CONFIG_GROUP,
+        key, &n, &error);
+
+    if (error) {
+        if (error->code != G_KEY_FILE_ERROR_KEY_NOT_FOUND &&
+            error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND) {
+            GWARN("%s: %s", key, GERRMSG(error));
+        }
+        g_error_free(error);
+        return FALSE;
+    } else {
+        guint64 mask = 0;
+
+        for (i = 0; i < n; i++) {
+            if (cpus[i] >= 0 && cpus[i] < BINDER_NFC_SCHED_MAX_CPUS) {
+                mask |= (G_GUINT64_CONSTANT(1) << cpus[i]);
+            } else {
+                GWARN("%s: invalid CPU %d", key, cpus[i]);
+            }
+        }
+        g_free(cpus);
+        *value = mask;
+        return TRUE;
+    }
+}
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+void
+binder_nfc_config_load(
+    BinderNfcConfig* config,
+    const char* path)
+{
+    GKeyFile* file = g_key_file_new();
+    GError* error = NULL;
+
+    /* Defaults */
+    memset(config, 0, sizeof(*config));
+    config->write_queue = BINDER_NFC_DEFAULT_WRITE_QUEUE;
+
+    if (g_key_file_load_from_file(file, path, G_KEY_FILE_NONE, &error)) {
+        gboolean bval;
+        int ival;
+
+        GDEBUG("Loading %s", path);
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_WRITE_QUEUE, &ival)) {
+            config->write_queue = CLAMP(ival, 1, BINDER_NFC_MAX_WRITE_QUEUE);
+            GDEBUG("  %s: %u", CONFIG_ENTRY_WRITE_QUEUE, config->write_queue);
+        }
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_CLOSE_DELAY, &ival)) {
+            config->close_delay_ms = CLAMP(ival, 0,
+                BINDER_NFC_MAX_CLOSE_DELAY_MS);
+            GDEBUG("  %s: %u ms", CONFIG_ENTRY_CLOSE_DELAY,
+                config->close_delay_ms);
+        }
+        if (binder_nfc_config_get_boolean(file, CONFIG_ENTRY_KEEP_CALLBACK,
+            &bval)) {
+            config->keep_callback = bval;
+            GDEBUG("  %s: %s", CONFIG_ENTRY_KEEP_CALLBACK,
+                bval ? "true" : "false");
+        }
+        if (binder_nfc_config_get_boolean(file,
+            CONFIG_ENTRY_HOST_SWITCHED_OFF, &bval)) {
+            config->host_switched_off = bval;
+            GDEBUG("  %s: %s", CONFIG_ENTRY_HOST_SWITCHED_OFF,
+                bval ? "true" : "false");
+        }
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_CALL_TIMEOUT,
+            &ival)) {
+            config->call_timeout_ms = CLAMP(ival, 0,
+                BINDER_NFC_MAX_TIMEOUT_MS);
+            GDEBUG("  %s: %u ms", CONFIG_ENTRY_CALL_TIMEOUT,
+                config->call_timeout_ms);
+        }
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_WRITE_TIMEOUT,
+            &ival)) {
+            config->write_timeout_ms = CLAMP(ival, 0,
+                BINDER_NFC_MAX_TIMEOUT_MS);
+            GDEBUG("  %s: %u ms", CONFIG_ENTRY_WRITE_TIMEOUT,
+                config->write_timeout_ms);
+        }
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_LOOP_PROBE,
+            &ival)) {
+            config->loop_probe_ms = CLAMP(ival, 0,
+                BINDER_NFC_MAX_LOOP_PROBE_MS);
+            GDEBUG("  %s: %u ms", CONFIG_ENTRY_LOOP_PROBE,
+                config->loop_probe_ms);
+        }
+        if (binder_nfc_config_get_boolean(file, CONFIG_ENTRY_BATCH_READS,
+            &bval)) {
+            config->batch_reads = bval;
+            GDEBUG("  %s: %s", CONFIG_ENTRY_BATCH_READS,
+                bval ? "true" : "false");
+        }
+        if (binder_nfc_config_get_boolean(file,
+            CONFIG_ENTRY_REASSEMBLE_PACKETS, &bval)) {
+            config->reassemble_packets = bval;
+            GDEBUG("  %s: %s", CONFIG_ENTRY_REASSEMBLE_PACKETS,
+                bval ? "true" : "false");
+        }
+        if (binder_nfc_config_get_boolean(file, CONFIG_ENTRY_DUMP_SIGNAL,
+            &bval)) {
+            config->dump_signal = bval;
+            GDEBUG("  %s: %s", CONFIG_ENTRY_DUMP_SIGNAL,
+                bval ? "true" : "false");
+        }
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_RT_PRIORITY,
+            &ival)) {
+            config->sched.rt_priority = CLAMP(ival, 0,
+                BINDER_NFC_SCHED_MAX_RT_PRIORITY);
+            GDEBUG("  %s: %d", CONFIG_ENTRY_RT_PRIORITY,
+                config->sched.rt_priority);
+        }
+        if (binder_nfc_config_get_int(file, CONFIG_ENTRY_NICE, &ival)) {
+            config->sched.nice = CLAMP(ival, BINDER_NFC_SCHED_MIN_NICE,
+                BINDER_NFC_SCHED_MAX_NICE);
+            GDEBUG("  %s: %d", CONFIG_ENTRY_NICE, config->sched.nice);
+        }
+        if (binder_nfc_config_get_cpu_mask(file, CONFIG_ENTRY_CPU_AFFINITY,
+            &config->sched.cpu_mask)) {
+            GDEBUG("  %s: 0x%" G_GINT64_MODIFIER "x",
+                CONFIG_ENTRY_CPU_AFFINITY, config->sched.cpu_mask);
+        }
+        config->service = g_key_file_get_string(file,
+            BINDER_NFC_CONFIG_GROUP, CONFIG_ENTRY_SERVICE, NULL);
+        if (config->service) {
+            g_strstrip(config->service);
+            if (config->service[0]) {
+                GDEBUG("  %s: %s", CONFIG_ENTRY_SERVICE, config->service);
+            } else {
+                g_free(config->service);
+                config->service = NULL;
+            }
+        }
+    } else {
+        if (error->domain != G_FILE_ERROR || error->code != G_FILE_ERROR_NOENT) {
+            GWARN("%s", GERRMSG(error));
+        }
+        g_error_free(error);
+    }
+    g_key_file_unref(file);
+}
+
+void
+binder_nfc_config_clear(
+    BinderNfcConfig* config)
+{
+    g_free(config->service);
+    config->service = NULL;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
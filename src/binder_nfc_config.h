@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_CONFIG_H
+#define BINDER_NFC_CONFIG_H
+
+#include "binder_nfc_sched.h"
+
+/*
+ * Optional plugin configuration, e.g.
+ *
+ * [Binder]
+ * WriteQueue = 4
+ * CloseDelay = 2000
+ * KeepCallback = true
+ * HostSwitchedOff = true
+ * CallTimeout = 10000
+ * WriteTimeout = 2000
+ * LoopProbe = 100
+ * BatchReads = true
+ * ReassemblePackets = true
+ * DumpSignal = true
+ * RealtimePriority = 10
+ * CpuAffinity = 4;5
+ * Service = android.hardware.nfc@1.1::INfc/default
+ */
+
+#ifndef BINDER_NFC_CONFIG_FILE
+#  define BINDER_NFC_CONFIG_FILE "/etc/nfcd/binder.conf"
+#endif
+
+#define BINDER_NFC_CONFIG_GROUP "Binder"
+
+#define BINDER_NFC_DEFAULT_WRITE_QUEUE (1)
+#define BINDER_NFC_MAX_WRITE_QUEUE (16)
+#define BINDER_NFC_MAX_CLOSE_DELAY_MS (60000)
+#define BINDER_NFC_MAX_TIMEOUT_MS (120000)
+#define BINDER_NFC_MAX_LOOP_PROBE_MS (60000)
+
+typedef struct binder_nfc_config {
+    guint write_queue;     /* Max number of queued NCI writes */
+    guint close_delay_ms;  /* Keep-warm period, zero to close right away */
+    gboolean keep_callback; /* Reuse the callback object after close */
+    gboolean host_switched_off; /* Low-power close while NFC is enabled */
+    guint call_timeout_ms; /* Deadline for HAL calls and events (opt-in) */
+    guint write_timeout_ms; /* Deadline for HAL writes (opt-in) */
+    guint loop_probe_ms; /* Main loop lag sampling period, or zero */
+    gboolean batch_reads; /* Deliver inbound packets in batches */
+    gboolean reassemble_packets; /* Split and join HAL payloads */
+    gboolean dump_signal; /* Log statistics on SIGUSR1 */
+    BinderNfcSched sched; /* Scheduling of the main thread */
+    char* service; /* Service to connect to right away, or NULL */
+} BinderNfcConfig;
+
+void
+binder_nfc_config_load(
+    BinderNfcConfig* config,
+    const char* file)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_config_clear(
+    BinderNfcConfig* config)
+    G_GNUC_INTERNAL;
+
+#endif /* BINDER_NFC_CONFIG_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "binder_nfc_framer.h"
+
+#include <string.h>
+
+#define HDR BINDER_NFC_NCI_HEADER_SIZE
+
+/* The last header byte is the payload length */
+#define PACKET_LEN(header) (HDR + ((const guint8*)(header))[2])
+
+/* Message type (data, command, response, notification) is 0..3 */
+#define PACKET_MT(header) ((((const guint8*)(header))[0] >> 5) & 0x07)
+#define PACKET_MT_MAX (3)
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+gsize
+binder_nfc_framer_append(
+    BinderNfcFramer* framer,
+    const guint8* data,
+    gsize size,
+    gsize want)
+{
+    const gsize n = MIN(want - framer->len, size);
+
+    memcpy(framer->buf + framer->len, data, n);
+    framer->len += n;
+    return n;
+}
+
+static
+void
+binder_nfc_framer_drop(
+    BinderNfcFramer* framer,
+    gsize len,
+    const char* what)
+{
+    GWARN("Dropping %u byte(s) of %s", (guint) len, what);
+    framer->dropped++;
+}
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+void
+binder_nfc_framer_input(
+    BinderNfcFramer* framer,
+    const void* data,
+    gsize size,
+    BinderNfcFramerFunc fn,
+    void* user_data)
+{
+    const guint8* ptr = data;
+    gsize left = size;
+
+    if (left >= HDR && PACKET_LEN(ptr) == left &&
+        PACKET_MT(ptr) <= PACKET_MT_MAX) {
+        /*
+         * The usual case, one complete packet. If something has been
+         * left from the previous payload, that's where we resync.
+         */
+        if (framer->len) {
+            binder_nfc_framer_drop(framer, framer->len,
+                "incomplete NCI packet");
+            framer->len = 0;
+        }
+        fn(ptr, left, user_data);
+        return;
+    } else if (!left) {
+        return;
+    }
+
+    framer->split++;
+    if (framer->len) {
+        gsize n;
+
+        /* Complete the header first, then the rest of the packet */
+        if (framer->len < HDR) {
+            n = binder_nfc_framer_append(framer, ptr, left, HDR);
+            ptr += n;
+            left -= n;
+        }
+        if (framer->len >= HDR) {
+            const gsize len = PACKET_LEN(framer->buf);
+
+            n = binder_nfc_framer_append(framer, ptr, left, len);
+            ptr += n;
+            left -= n;
+            if (framer->len == len) {
+                framer->len = 0;
+                framer->joined++;
+                fn(framer->buf, len, user_data);
+            }
+        }
+    }
+
+    /* Complete packets are passed through without copying */
+    while (left >= HDR && PACKET_MT(ptr) <= PACKET_MT_MAX &&
+        PACKET_LEN(ptr) <= left) {
+        const gsize len = PACKET_LEN(ptr);
+
+        fn(ptr, len, user_data);
+        ptr += len;
+        left -= len;
+    }
+
+    if (left && PACKET_MT(ptr) > PACKET_MT_MAX) {
+        /* Not an NCI header, the rest of the payload is garbage */
+        binder_nfc_framer_drop(framer, left, "garbage");
+    } else if (left) {
+        /* Keep the beginning of the next one */
+        GASSERT(!framer->len);
+        memcpy(framer->buf, ptr, left);
+        framer->len = left;
+    }
+}
+
+void
+binder_nfc_framer_reset(
+    BinderNfcFramer* framer)
+{
+    if (framer->len) {
+        binder_nfc_framer_drop(framer, framer->len, "incomplete NCI packet");
+        framer->len = 0;
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_FRAMER_H
+#define BINDER_NFC_FRAMER_H
+
+#include "binder_nfc_types.h"
+
+/*
+ * Splits HAL payloads into NCI packets. Normally each sendData callback
+ * carries exactly one packet, which is passed through as is. Some HALs
+ * however may pack several packets into one callback or split a packet
+ * between callbacks. Incomplete packets are collected in a preallocated
+ * buffer until the rest arrives. A payload which is exactly one packet
+ * always starts a new one (whatever was left from before is dropped),
+ * and so does the next payload after something that doesn't look like
+ * an NCI header (which is dropped too).
+ */
+
+typedef
+void
+(*BinderNfcFramerFunc)(
+    const void* packet,
+    gsize len,
+    void* user_data);
+
+typedef struct binder_nfc_framer {
+    gsize len;          /* Number of bytes in the buffer */
+    guint split;        /* Payloads which weren't exactly one packet */
+    guint joined;       /* Packets put together from pieces */
+    guint dropped;      /* Incomplete packets thrown away */
+    guint8 buf[BINDER_NFC_NCI_PACKET_MAX];
+} BinderNfcFramer;
+
+void
+binder_nfc_framer_input(
+    BinderNfcFramer* framer,
+    const void* data,
+    gsize size,
+    BinderNfcFramerFunc fn,
+    void* user_data)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_framer_reset(
+    BinderNfcFramer* framer)
+    G_GNUC_INTERNAL;
+
+#endif /* BINDER_NFC_FRAMER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -40,6 +40,9 @@
 #include "binder_nfc_adapter.h"
 #include "binder_nfc_api_aidl.h"
 #include "binder_nfc_api_hidl.h"
+#include "binder_nfc_cache.h"
+#include "binder_nfc_config.h"
+#include "binder_nfc_sched.h"
 #include "binder_nfc_watcher.h"
 #include "plugin.h"
 
@@ -53,27 +56,65 @@
 
 #include <gutil_misc.h>
 
+#include <glib-unix.h>
+
+#include <signal.h>
+
 GLOG_MODULE_DEFINE("binder");
 
+typedef struct binder_nfc_plugin BinderNfcPlugin;
+
 typedef struct binder_nfc_plugin_adapter_entry {
+    BinderNfcPlugin* plugin;
+    const BinderNfcBackend* backend;
+    char* fqname;
     gulong death_id;
     NfcAdapter* adapter;
+    GBinderServiceManager* sm;
+    gulong get_id;
+    guint timer_id;
+    guint retry_ms;
+    guint deaths;
+    guint reconnects;
+    gboolean dead;
+    gboolean polling;
+    gint64 death_time;
+    gint64 connect_time;
 } BinderNfcPluginEntry;
 
+/*
+ * A dead HAL is given some time to come back. If it dies again soon
+ * after having been reconnected, each subsequent reconnect is delayed
+ * by twice as long. Eventually, if it keeps dying, we give up.
+ */
+#define BINDER_NFC_RECONNECT_MIN_MS     (250)
+#define BINDER_NFC_RECONNECT_MAX_MS     (30000)
+#define BINDER_NFC_RECONNECT_STABLE_MS  (60000)
+#define BINDER_NFC_RECONNECT_GIVE_UP_MS (120000)
+#define BINDER_NFC_RECONNECT_MAX_DEATHS (8)
+
 typedef struct binder_nfc_plugin_start_watch_entry {
     gulong watch_id;
     BinderNfcWatcher* watcher;
 } BinderNfcStartWatchEntry;
 
 typedef NfcPluginClass BinderNfcPluginClass;
-typedef struct binder_nfc_plugin {
+struct binder_nfc_plugin {
     NfcPlugin parent;
     NfcManager* manager;
+    BinderNfcConfig config;
     GHashTable* adapters;
     GSList* start_watches;
     BinderNfcWatcher* watcher;
     gulong watch_id;
-} BinderNfcPlugin;
+    const BinderNfcBackend* direct_backend;
+    GBinderServiceManager* direct_sm;
+    char* direct_fqname;
+    gulong direct_id;
+    gint64 start_time;
+    guint dump_id;
+    BinderNfcSchedSaved* sched;
+};
 
 #define PARENT_CLASS binder_nfc_plugin_parent_class
 #define PARENT_TYPE NFC_TYPE_PLUGIN
@@ -107,26 +148,161 @@ static const BinderNfcBackend binder_nfc_backends[] = {
  * Implementation
  *==========================================================================*/
 
+static
+void
+binder_nfc_plugin_entry_drop(
+    BinderNfcPluginEntry* entry)
+{
+    BinderNfcPlugin* self = entry->plugin;
+
+    /* This deallocates the entry */
+    GWARN("NFC adapter \"%s\" has disappeared", entry->adapter->name);
+    nfc_manager_remove_adapter(self->manager, entry->adapter->name);
+    g_hash_table_remove(self->adapters, entry->fqname);
+}
+
+static
+void
+binder_nfc_plugin_entry_stop(
+    BinderNfcPluginEntry* entry)
+{
+    if (entry->timer_id) {
+        g_source_remove(entry->timer_id);
+        entry->timer_id = 0;
+    }
+    if (entry->get_id) {
+        gbinder_servicemanager_cancel(entry->sm, entry->get_id);
+        entry->get_id = 0;
+    }
+    entry->polling = FALSE;
+}
+
+static
+gboolean
+binder_nfc_plugin_entry_rebind(
+    BinderNfcPluginEntry* entry,
+    GBinderRemoteObject* remote)
+{
+    BinderNfcApi* api = entry->backend->api(remote);
+
+    if (!api) {
+        /* Keep polling, the caller knows when to give up */
+        GWARN("Failed to attach to %s", entry->fqname);
+        return FALSE;
+    } else {
+        const gint64 now = g_get_monotonic_time();
+
+        binder_nfc_plugin_entry_stop(entry);
+        GINFO("NFC adapter \"%s\" reconnected to %s in %u ms",
+            entry->adapter->name, entry->fqname,
+            (guint)((now - entry->death_time) / 1000));
+        entry->dead = FALSE;
+        entry->connect_time = now;
+        entry->reconnects++;
+        binder_nfc_adapter_set_api(entry->adapter, api);
+        g_object_unref(api);
+        return TRUE;
+    }
+}
+
+static
+gboolean
+binder_nfc_plugin_entry_poll(
+    BinderNfcPluginEntry* entry);
+
+static
+gboolean
+binder_nfc_plugin_entry_poll_timer(
+    gpointer data)
+{
+    BinderNfcPluginEntry* entry = data;
+
+    entry->timer_id = 0;
+    if (!binder_nfc_plugin_entry_poll(entry)) {
+        binder_nfc_plugin_entry_drop(entry);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static
+void
+binder_nfc_plugin_entry_poll_reply(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* remote,
+    int status,
+    void* data)
+{
+    BinderNfcPluginEntry* entry = data;
+
+    entry->get_id = 0;
+    if (!remote || gbinder_remote_object_is_dead(remote) ||
+        !binder_nfc_plugin_entry_rebind(entry, remote)) {
+        if ((g_get_monotonic_time() - entry->death_time) / 1000 >
+            BINDER_NFC_RECONNECT_GIVE_UP_MS) {
+            GWARN("%s didn't come back", entry->fqname);
+            binder_nfc_plugin_entry_drop(entry);
+        } else {
+            GDEBUG("%s is not there yet, retrying in %u ms", entry->fqname,
+                entry->retry_ms);
+            entry->timer_id = g_timeout_add(entry->retry_ms,
+                binder_nfc_plugin_entry_poll_timer, entry);
+            entry->retry_ms = MIN(entry->retry_ms * 2,
+                BINDER_NFC_RECONNECT_MAX_MS);
+        }
+    }
+}
+
+static
+gboolean
+binder_nfc_plugin_entry_poll(
+    BinderNfcPluginEntry* entry)
+{
+    /*
+     * The plugin's watcher (if there is one) may be faster to notice
+     * that the service is back but polling doesn't hurt either.
+     */
+    entry->polling = TRUE;
+    if (!entry->sm) {
+        entry->sm = gbinder_servicemanager_new(entry->backend->dev);
+    }
+    if (entry->sm) {
+        entry->get_id = gbinder_servicemanager_get_service(entry->sm,
+            entry->fqname, binder_nfc_plugin_entry_poll_reply, entry);
+    }
+    return entry->get_id != 0;
+}
+
 static
 void
 binder_nfc_plugin_adapter_death_proc(
     NfcAdapter* adapter,
-    void* plugin)
+    void* data)
 {
-    BinderNfcPlugin* self = THIS(plugin);
-    GHashTableIter it;
-    gpointer key, value;
+    BinderNfcPluginEntry* entry = data;
+    const gint64 now = g_get_monotonic_time();
 
-    g_hash_table_iter_init(&it, self->adapters);
-    while (g_hash_table_iter_next(&it, &key, &value)) {
-        BinderNfcPluginEntry* entry = value;
+    /* Count the deaths which happen soon after (re)connecting */
+    if ((now - entry->connect_time) / 1000 < BINDER_NFC_RECONNECT_STABLE_MS) {
+        entry->deaths++;
+    } else {
+        entry->deaths = 1;
+    }
 
-        if (entry->adapter == adapter) {
-            GWARN("NFC adapter \"%s\" has disappeared", adapter->name);
-            nfc_manager_remove_adapter(self->manager, adapter->name);
-            g_hash_table_iter_remove(&it);
-            break;
-        }
+    binder_nfc_plugin_entry_stop(entry);
+    entry->dead = TRUE;
+    entry->death_time = now;
+    if (entry->deaths > BINDER_NFC_RECONNECT_MAX_DEATHS) {
+        GWARN("%s keeps dying, giving up", entry->fqname);
+        binder_nfc_plugin_entry_drop(entry);
+    } else {
+        const guint delay = (entry->deaths > 1) ?
+            MIN(BINDER_NFC_RECONNECT_MIN_MS << (entry->deaths - 2),
+                BINDER_NFC_RECONNECT_MAX_MS) : 0;
+
+        GWARN("%s died, reconnecting in %u ms", entry->fqname, delay);
+        entry->retry_ms = BINDER_NFC_RECONNECT_MIN_MS;
+        entry->timer_id = g_timeout_add(delay,
+            binder_nfc_plugin_entry_poll_timer, entry);
     }
 }
 
@@ -137,8 +313,11 @@ binder_nfc_plugin_adapter_entry_destroy(
 {
     BinderNfcPluginEntry* entry = data;
 
+    binder_nfc_plugin_entry_stop(entry);
+    gbinder_servicemanager_unref(entry->sm);
     nfc_adapter_remove_handler(entry->adapter, entry->death_id);
     nfc_adapter_unref(entry->adapter);
+    g_free(entry->fqname);
     g_free(entry);
 }
 
@@ -150,13 +329,30 @@ binder_nfc_plugin_add_adapter(
     const BinderNfcBackend* backend,
     const char* fqname)
 {
-    BinderNfcApi* api = backend->api(remote);
-    BinderNfcPluginEntry* entry = g_new0(BinderNfcPluginEntry, 1);
+    BinderNfcApi* api;
+    BinderNfcPluginEntry* entry = g_hash_table_lookup(self->adapters, fqname);
+
+    if (entry) {
+        if (entry->dead && entry->polling) {
+            /* The service is back, polling continues if rebind fails */
+            binder_nfc_plugin_entry_rebind(entry, remote);
+        } else {
+            /* The watcher may find the one we have connected to directly */
+            GDEBUG("%s is already there", fqname);
+        }
+        return;
+    }
 
-    entry->adapter = binder_nfc_adapter_new(api);
+    api = backend->api(remote);
+    entry = g_new0(BinderNfcPluginEntry, 1);
+    entry->plugin = self;
+    entry->backend = backend;
+    entry->fqname = g_strdup(fqname);
+    entry->connect_time = g_get_monotonic_time();
+    entry->adapter = binder_nfc_adapter_new(api, &self->config);
     entry->death_id = binder_nfc_adapter_add_death_handler(entry->adapter,
-        binder_nfc_plugin_adapter_death_proc, self);
-    g_hash_table_insert(self->adapters, g_strdup(fqname), entry);
+        binder_nfc_plugin_adapter_death_proc, entry);
+    g_hash_table_insert(self->adapters, entry->fqname, entry);
     nfc_manager_add_adapter(self->manager, entry->adapter);
     GINFO("NFC adapter %s (%s) => \"%s\"", fqname, backend->name,
         entry->adapter->name);
@@ -187,6 +383,19 @@ binder_nfc_plugin_watch_proc(
         fqname);
 }
 
+static
+void
+binder_nfc_plugin_use_watcher(
+    BinderNfcPlugin* self,
+    BinderNfcWatcher* watcher)
+{
+    GDEBUG("Using %s backend", watcher->backend->name);
+    GASSERT(!self->watcher);
+    g_object_ref(self->watcher = watcher);
+    self->watch_id = binder_nfc_watcher_add_handler(watcher,
+        binder_nfc_plugin_watch_proc, self);
+}
+
 static
 void
 binder_nfc_plugin_start_watch_proc(
@@ -199,21 +408,161 @@ binder_nfc_plugin_start_watch_proc(
 
     /* From this point on we keep using the watcher which found the first
      * NFC service. */
-    GDEBUG("Using %s backend", watcher->backend->name);
-    GASSERT(!self->watcher);
-    g_object_ref(self->watcher = watcher);
-    self->watch_id = binder_nfc_watcher_add_handler(watcher,
-        binder_nfc_plugin_watch_proc, self);
+    GDEBUG("Found %s in %u ms", fqname, (guint)
+        ((g_get_monotonic_time() - self->start_time) / 1000));
+    binder_nfc_plugin_use_watcher(self, watcher);
 
     /* Drop the initial watchers */
     g_slist_free_full(self->start_watches,
         binder_nfc_plugin_start_watch_entry_destroy);
     self->start_watches = NULL;
 
+    /* Connect directly next time */
+    if (!self->config.service) {
+        binder_nfc_cache_set_service(BINDER_NFC_CACHE_FILE, fqname);
+    }
+
     /* Add this adapter */
     binder_nfc_plugin_add_adapter(self, remote, watcher->backend, fqname);
 }
 
+static
+void
+binder_nfc_plugin_probe(
+    BinderNfcPlugin* self)
+{
+    guint i;
+
+    /* Watch both binder devices, the first one to find NFC wins */
+    GASSERT(!self->start_watches);
+    for (i = 0; i < N_BACKENDS; i++) {
+        BinderNfcStartWatchEntry* entry = g_new0(BinderNfcStartWatchEntry, 1);
+
+        entry->watcher = binder_nfc_watcher_new(binder_nfc_backends + i);
+        entry->watch_id = binder_nfc_watcher_add_handler(entry->watcher,
+            binder_nfc_plugin_start_watch_proc, self);
+        self->start_watches = g_slist_append(self->start_watches, entry);
+    }
+}
+
+static
+void
+binder_nfc_plugin_direct_done(
+    BinderNfcPlugin* self)
+{
+    gbinder_servicemanager_cancel(self->direct_sm, self->direct_id);
+    gbinder_servicemanager_unref(self->direct_sm);
+    g_free(self->direct_fqname);
+    self->direct_backend = NULL;
+    self->direct_sm = NULL;
+    self->direct_fqname = NULL;
+    self->direct_id = 0;
+}
+
+static
+void
+binder_nfc_plugin_direct_reply(
+    GBinderServiceManager* sm,
+    GBinderRemoteObject* remote,
+    int status,
+    void* plugin)
+{
+    BinderNfcPlugin* self = THIS(plugin);
+    const BinderNfcBackend* backend = self->direct_backend;
+    char* fqname = self->direct_fqname;
+
+    self->direct_id = 0;
+    self->direct_fqname = NULL;
+    if (remote) {
+        BinderNfcWatcher* watcher = binder_nfc_watcher_new(backend);
+
+        GDEBUG("Connected to %s in %u ms", fqname, (guint)
+            ((g_get_monotonic_time() - self->start_time) / 1000));
+
+        /* Keep watching this backend for the service to come and go */
+        if (watcher) {
+            binder_nfc_plugin_use_watcher(self, watcher);
+            g_object_unref(watcher);
+        }
+        binder_nfc_plugin_add_adapter(self, remote, backend, fqname);
+    } else {
+        /*
+         * Most likely, the HAL hasn't registered yet. The cache stays
+         * as is, if the probe finds something else it gets updated.
+         */
+        GDEBUG("%s isn't there yet, probing", fqname);
+        binder_nfc_plugin_probe(self);
+    }
+
+    /* The service manager is released by binder_nfc_plugin_direct_done() */
+    g_free(fqname);
+}
+
+static
+gboolean
+binder_nfc_plugin_direct(
+    BinderNfcPlugin* self,
+    char* fqname /* Takes ownership */)
+{
+    guint i;
+
+    /* Figure out the backend by the name */
+    for (i = 0; i < N_BACKENDS; i++) {
+        const BinderNfcBackend* backend = binder_nfc_backends + i;
+
+        if (binder_nfc_watcher_name_match(backend->watch, fqname)) {
+            GBinderServiceManager* sm = gbinder_servicemanager_new
+                (backend->dev);
+
+            if (sm) {
+                GDEBUG("Connecting to %s (%s)", fqname, backend->name);
+                self->direct_backend = backend;
+                self->direct_sm = sm;
+                self->direct_fqname = fqname;
+                self->direct_id = gbinder_servicemanager_get_service(sm,
+                    fqname, binder_nfc_plugin_direct_reply, self);
+                if (self->direct_id) {
+                    return TRUE;
+                }
+                binder_nfc_plugin_direct_done(self);
+                return FALSE;
+            }
+            GWARN("Can't connect to %s", fqname);
+            g_free(fqname);
+            return FALSE;
+        }
+    }
+    GWARN("%s is not an NFC service", fqname);
+    if (!self->config.service) {
+        /* Don't try it again */
+        binder_nfc_cache_set_service(BINDER_NFC_CACHE_FILE, NULL);
+    }
+    g_free(fqname);
+    return FALSE;
+}
+
+static
+gboolean
+binder_nfc_plugin_dump_proc(
+    gpointer plugin)
+{
+    BinderNfcPlugin* self = THIS(plugin);
+    GHashTableIter it;
+    gpointer value;
+
+    /* SIGUSR1 dumps the statistics */
+    g_hash_table_iter_init(&it, self->adapters);
+    while (g_hash_table_iter_next(&it, NULL, &value)) {
+        BinderNfcPluginEntry* entry = value;
+
+        if (entry->reconnects) {
+            GINFO("%s: %u reconnect(s)", entry->fqname, entry->reconnects);
+        }
+        binder_nfc_adapter_dump(entry->adapter);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 /*==========================================================================*
  * Methods
  *==========================================================================*/
@@ -224,20 +573,31 @@ binder_nfc_plugin_start(
     NfcPlugin* plugin,
     NfcManager* manager)
 {
-    guint i;
     BinderNfcPlugin* self = THIS(plugin);
+    char* fqname;
 
     GASSERT(!self->start_watches);
     GASSERT(!self->watcher);
-    for (i = 0; i < N_BACKENDS; i++) {
-        BinderNfcStartWatchEntry* entry = g_new0(BinderNfcStartWatchEntry, 1);
-
-        entry->watcher = binder_nfc_watcher_new(binder_nfc_backends + i);
-        entry->watch_id = binder_nfc_watcher_add_handler(entry->watcher,
-            binder_nfc_plugin_start_watch_proc, self);
-        self->start_watches = g_slist_append(self->start_watches, entry);
+    self->start_time = g_get_monotonic_time();
+    binder_nfc_config_load(&self->config, BINDER_NFC_CONFIG_FILE);
+    self->sched = binder_nfc_sched_apply(&self->config.sched);
+
+    /*
+     * If we know which service to use (either from the config or
+     * because we found it last time), try to connect to it directly.
+     * Probing is the fallback.
+     */
+    fqname = self->config.service ? g_strdup(self->config.service) :
+        binder_nfc_cache_get_service(BINDER_NFC_CACHE_FILE);
+    if (!fqname || !binder_nfc_plugin_direct(self, fqname)) {
+        binder_nfc_plugin_probe(self);
     }
     self->manager = nfc_manager_ref(manager);
+    if (self->config.dump_signal) {
+        /* The signal belongs to the whole process, hence opt-in */
+        self->dump_id = g_unix_signal_add(SIGUSR1,
+            binder_nfc_plugin_dump_proc, self);
+    }
     return TRUE;
 }
 
@@ -249,11 +609,16 @@ binder_nfc_plugin_stop(
     BinderNfcPlugin* self = THIS(plugin);
 
     GVERBOSE("Stopping");
+    if (self->dump_id) {
+        g_source_remove(self->dump_id);
+        self->dump_id = 0;
+    }
     if (self->start_watches) {
         g_slist_free_full(self->start_watches,
             binder_nfc_plugin_start_watch_entry_destroy);
         self->start_watches = NULL;
     }
+    binder_nfc_plugin_direct_done(self);
     if (self->watcher) {
         g_signal_handler_disconnect(self->watcher, self->watch_id);
         g_object_unref(self->watcher);
@@ -274,6 +639,9 @@ binder_nfc_plugin_stop(
         nfc_manager_unref(self->manager);
         self->manager = NULL;
     }
+    binder_nfc_sched_restore(self->sched);
+    self->sched = NULL;
+    binder_nfc_config_clear(&self->config);
 }
 
 /*==========================================================================*
@@ -285,8 +653,9 @@ void
 binder_nfc_plugin_init(
     BinderNfcPlugin* self)
 {
+    /* Keys are owned by the entries */
     self->adapters = g_hash_table_new_full(g_str_hash, g_str_equal,
-        g_free, binder_nfc_plugin_adapter_entry_destroy);
+        NULL, binder_nfc_plugin_adapter_entry_destroy);
 }
 
 static
@@ -296,6 +665,8 @@ binder_nfc_plugin_finalize(
 {
     BinderNfcPlugin* self = THIS(object);
 
+    binder_nfc_plugin_direct_done(self);
+    binder_nfc_config_clear(&self->config);
     g_hash_table_destroy(self->adapters);
     G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
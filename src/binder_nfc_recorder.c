@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "binder_nfc_recorder.h"
+
+#include <gutil_misc.h>
+
+#include <string.h>
+
+/*==========================================================================*
+ * API
+ *==========================================================================*/
+
+void
+binder_nfc_recorder_add(
+    BinderNfcRecorder* self,
+    char dir,
+    const void* data,
+    gsize len)
+{
+    BinderNfcRecorderEntry* entry = self->entry +
+        (self->count % BINDER_NFC_RECORDER_SIZE);
+
+    /* Only the beginning of an oversized packet is kept */
+    entry->time = g_get_monotonic_time();
+    entry->len = (guint) len;
+    entry->dir = dir;
+    memcpy(entry->data, data, MIN(len, sizeof(entry->data)));
+    self->count++;
+}
+
+void
+binder_nfc_recorder_add_chunks(
+    BinderNfcRecorder* self,
+    char dir,
+    const GUtilData* chunks,
+    guint count)
+{
+    BinderNfcRecorderEntry* entry = self->entry +
+        (self->count % BINDER_NFC_RECORDER_SIZE);
+    gsize len = 0, off = 0;
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        const gsize n = MIN(chunks[i].size, sizeof(entry->data) - off);
+
+        memcpy(entry->data + off, chunks[i].bytes, n);
+        len += chunks[i].size;
+        off += n;
+    }
+    entry->time = g_get_monotonic_time();
+    entry->len = (guint) len;
+    entry->dir = dir;
+    self->count++;
+}
+
+void
+binder_nfc_recorder_dump(
+    BinderNfcRecorder* self,
+    const char* name,
+    const char* reason)
+{
+    /* Only the packets recorded since the last dump get dumped */
+    if (self->count != self->dumped) {
+        const guint n = MIN(self->count - self->dumped,
+            BINDER_NFC_RECORDER_SIZE);
+        const gint64 now = g_get_monotonic_time();
+        const int level = GLOG_LEVEL_WARN;
+        GLogModule* log = &binder_hexdump_log;
+        guint i;
+
+        GWARN("%s: last %u NCI packet(s), %s", name, n, reason);
+        for (i = self->count - n; i < self->count; i++) {
+            const BinderNfcRecorderEntry* entry = self->entry +
+                (i % BINDER_NFC_RECORDER_SIZE);
+            const guint8* ptr = entry->data;
+            int len = MIN(entry->len, sizeof(entry->data));
+
+            gutil_log(log, level, "%c -%.3f s, %u byte(s)", entry->dir,
+                (now - entry->time) / (double) G_USEC_PER_SEC, entry->len);
+            while (len > 0) {
+                char buf[GUTIL_HEXDUMP_BUFSIZE];
+                const guint consumed = gutil_hexdump(buf, ptr, len);
+
+                len -= consumed;
+                ptr += consumed;
+                gutil_log(log, level, "  %s", buf);
+            }
+        }
+        self->dumped = self->count;
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_RECORDER_H
+#define BINDER_NFC_RECORDER_H
+
+#include "binder_nfc_types.h"
+
+/*
+ * NCI flight recorder. Keeps the last few packets in a preallocated
+ * ring buffer so that they can be dumped when something goes wrong.
+ */
+
+#ifndef BINDER_NFC_RECORDER_SIZE
+#  define BINDER_NFC_RECORDER_SIZE (32)
+#endif
+
+typedef struct binder_nfc_recorder_entry {
+    gint64 time;
+    guint len;
+    char dir;
+    guint8 data[BINDER_NFC_NCI_PACKET_MAX];
+} BinderNfcRecorderEntry;
+
+typedef struct binder_nfc_recorder {
+    guint count;    /* Total number of recorded packets */
+    guint dumped;   /* Value of count at the time of the last dump */
+    BinderNfcRecorderEntry entry[BINDER_NFC_RECORDER_SIZE];
+} BinderNfcRecorder;
+
+void
+binder_nfc_recorder_add(
+    BinderNfcRecorder* recorder,
+    char dir,
+    const void* data,
+    gsize len)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_recorder_add_chunks(
+    BinderNfcRecorder* recorder,
+    char dir,
+    const GUtilData* chunks,
+    guint count)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_recorder_dump(
+    BinderNfcRecorder* recorder,
+    const char* name,
+    const char* reason)
+    G_GNUC_INTERNAL;
+
+#endif /* BINDER_NFC_RECORDER_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
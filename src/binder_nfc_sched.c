@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#define _GNU_SOURCE /* CPU_SET and friends */
+
+#include "binder_nfc_sched.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/* What the thread had before binder_nfc_sched_apply() */
+struct binder_nfc_sched_saved {
+    gboolean policy_saved;
+    int policy;
+    struct sched_param param;
+    gboolean nice_saved;
+    int nice;
+    gboolean affinity_saved;
+    cpu_set_t affinity;
+};
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+pid_t
+binder_nfc_sched_gettid(
+    void)
+{
+    /* On Linux, PRIO_PROCESS with a thread id only affects that thread */
+    return (pid_t)syscall(SYS_gettid);
+}
+
+static
+gboolean
+binder_nfc_sched_set_rt_priority(
+    int priority)
+{
+    struct sched_param param;
+    int err;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) {
+        GWARN("Failed to set SCHED_FIFO priority %d: %s", priority,
+            strerror(err));
+        return FALSE;
+    }
+    GDEBUG("SCHED_FIFO priority %d", priority);
+    return TRUE;
+}
+
+static
+gboolean
+binder_nfc_sched_set_nice(
+    int nice)
+{
+    if (setpriority(PRIO_PROCESS, binder_nfc_sched_gettid(), nice) < 0) {
+        GWARN("Failed to set nice %d: %s", nice, strerror(errno));
+        return FALSE;
+    }
+    GDEBUG("Nice %d", nice);
+    return TRUE;
+}
+
+static
+gboolean
+binder_nfc_sched_set_affinity(
+    guint64 mask)
+{
+    cpu_set_t set;
+    guint i;
+
+    CPU_ZERO(&set);
+    for (i = 0; i < BINDER_NFC_SCHED_MAX_CPUS; i++) {
+        if (mask & (G_GUINT64_CONSTANT(1) << i)) {
+            CPU_SET(i, &set);
+        }
+    }
+
+    /* Zero pid means the calling thread */
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        GWARN("Failed to set CPU affinity 0x%" G_GINT64_MODIFIER "x: %s",
+            mask, strerror(errno));
+        return FALSE;
+    }
+    GDEBUG("CPU affinity 0x%" G_GINT64_MODIFIER "x", mask);
+    return TRUE;
+}
+
+/*==========================================================================*
+ * Internal API
+ *==========================================================================*/
+
+BinderNfcSchedSaved*
+binder_nfc_sched_apply(
+    const BinderNfcSched* sched)
+{
+    BinderNfcSchedSaved* saved = g_new0(BinderNfcSchedSaved, 1);
+
+    /* Nice value has no effect on real-time threads */
+    if (sched->rt_priority > 0) {
+        if (!pthread_getschedparam(pthread_self(), &saved->policy,
+            &saved->param)) {
+            saved->policy_saved =
+                binder_nfc_sched_set_rt_priority(sched->rt_priority);
+        }
+    } else if (sched->nice) {
+        const pid_t tid = binder_nfc_sched_gettid();
+
+        /* -1 is a valid priority, errno tells the difference */
+        errno = 0;
+        saved->nice = getpriority(PRIO_PROCESS, tid);
+        if (!errno) {
+            saved->nice_saved = binder_nfc_sched_set_nice(sched->nice);
+        }
+    }
+    if (sched->cpu_mask) {
+        if (sched_getaffinity(0, sizeof(saved->affinity),
+            &saved->affinity) == 0) {
+            saved->affinity_saved =
+                binder_nfc_sched_set_affinity(sched->cpu_mask);
+        }
+    }
+    if (saved->policy_saved || saved->nice_saved || saved->affinity_saved) {
+        return saved;
+    } else {
+        g_free(saved);
+        return NULL;
+    }
+}
+
+void
+binder_nfc_sched_restore(
+    BinderNfcSchedSaved* saved)
+{
+    if (saved) {
+        if (saved->policy_saved) {
+            const int err = pthread_setschedparam(pthread_self(),
+                saved->policy, &saved->param);
+
+            if (err) {
+                GWARN("Failed to restore scheduling policy: %s",
+                    strerror(err));
+            }
+        }
+        if (saved->nice_saved && setpriority(PRIO_PROCESS,
+            binder_nfc_sched_gettid(), saved->nice) < 0) {
+            GWARN("Failed to restore nice %d: %s", saved->nice,
+                strerror(errno));
+        }
+        if (saved->affinity_saved && sched_setaffinity(0,
+            sizeof(saved->affinity), &saved->affinity) < 0) {
+            GWARN("Failed to restore CPU affinity: %s", strerror(errno));
+        }
+        GDEBUG("Scheduling restored");
+        g_free(saved);
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_SCHED_H
+#define BINDER_NFC_SCHED_H
+
+#include "binder_nfc_types.h"
+
+/*
+ * Scheduling of the calling thread. Everything on the NFC I/O path
+ * (HAL callbacks, NCI packet delivery and writes) is done by the main
+ * thread, so that's the thread which gets the treatment. Since that
+ * thread isn't ours, whatever binder_nfc_sched_apply() has changed is
+ * put back by binder_nfc_sched_restore().
+ */
+
+#define BINDER_NFC_SCHED_MAX_RT_PRIORITY (99)
+#define BINDER_NFC_SCHED_MIN_NICE (-20)
+#define BINDER_NFC_SCHED_MAX_NICE (19)
+#define BINDER_NFC_SCHED_MAX_CPUS (64)
+
+typedef struct binder_nfc_sched {
+    int rt_priority;   /* SCHED_FIFO priority, zero to leave the policy */
+    int nice;          /* Used if rt_priority is zero, zero to leave it */
+    guint64 cpu_mask;  /* CPU affinity, zero to leave it alone */
+} BinderNfcSched;
+
+typedef struct binder_nfc_sched_saved BinderNfcSchedSaved;
+
+BinderNfcSchedSaved*
+binder_nfc_sched_apply(
+    const BinderNfcSched* sched)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_sched_restore(
+    BinderNfcSchedSaved* saved)
+    G_GNUC_INTERNAL;
+
+#endif /* BINDER_NFC_SCHED_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
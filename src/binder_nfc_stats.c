@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "binder_nfc_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*==========================================================================*
+ * BinderNfcHistogram
+ *==========================================================================*/
+
+void
+binder_nfc_histogram_add(
+    BinderNfcHistogram* hist,
+    gint64 us)
+{
+    const gint64 value = MAX(us, 0);
+    const gint64 last = (gint64)1 << (BINDER_NFC_HISTOGRAM_BUCKETS - 1);
+
+    hist->bucket[(value >= last) ? (BINDER_NFC_HISTOGRAM_BUCKETS - 1) :
+        value ? g_bit_storage((gulong) value) : 0]++;
+    hist->count++;
+    hist->total += value;
+    if (hist->max < value) {
+        hist->max = value;
+    }
+}
+
+gint64
+binder_nfc_histogram_average(
+    const BinderNfcHistogram* hist)
+{
+    return hist->count ? (hist->total / hist->count) : 0;
+}
+
+gint64
+binder_nfc_histogram_percentile(
+    const BinderNfcHistogram* hist,
+    guint permille)
+{
+    if (hist->count) {
+        /* Rank of the sample we are looking for, 1-based */
+        const guint64 rank = MAX(((guint64)hist->count * permille +
+            999) / 1000, 1);
+        guint64 seen = 0;
+        guint i;
+
+        for (i = 0; i < BINDER_NFC_HISTOGRAM_BUCKETS - 1; i++) {
+            seen += hist->bucket[i];
+            if (seen >= rank) {
+                /* Upper bound of the bucket but no more than the max */
+                return MIN(i ? (((gint64)1 << i) - 1) : 0, hist->max);
+            }
+        }
+        return hist->max;
+    }
+    return 0;
+}
+
+/*==========================================================================*
+ * BinderNfcWindow
+ *==========================================================================*/
+
+static
+int
+binder_nfc_window_compare(
+    const void* a,
+    const void* b)
+{
+    const gint64 x = *(const gint64*)a;
+    const gint64 y = *(const gint64*)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+void
+binder_nfc_window_add(
+    BinderNfcWindow* window,
+    gint64 value)
+{
+    window->sample[window->next] = value;
+    window->next = (window->next + 1) % BINDER_NFC_WINDOW_SIZE;
+    if (window->count < BINDER_NFC_WINDOW_SIZE) {
+        window->count++;
+    }
+}
+
+gint64
+binder_nfc_window_percentile(
+    const BinderNfcWindow* window,
+    guint permille)
+{
+    const guint n = window->count;
+
+    if (n) {
+        gint64 sorted[BINDER_NFC_WINDOW_SIZE];
+        const guint i = (guint)(((guint64)n * permille) / 1000);
+
+        /* Slots [0..count) are always filled */
+        memcpy(sorted, window->sample, n * sizeof(sorted[0]));
+        qsort(sorted, n, sizeof(sorted[0]), binder_nfc_window_compare);
+        return sorted[MIN(i, n - 1)];
+    }
+    return 0;
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
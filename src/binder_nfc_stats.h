@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_STATS_H
+#define BINDER_NFC_STATS_H
+
+#include "binder_nfc_types.h"
+
+/*
+ * Log-bucketed latency histogram. Bucket 0 counts zero-length samples,
+ * bucket N counts samples in [2^(N-1), 2^N) microseconds, the last one
+ * also takes everything above that.
+ */
+
+#define BINDER_NFC_HISTOGRAM_BUCKETS (25) /* Up to ~16 seconds */
+
+typedef struct binder_nfc_histogram {
+    guint count;
+    gint64 total;
+    gint64 max;
+    guint bucket[BINDER_NFC_HISTOGRAM_BUCKETS];
+} BinderNfcHistogram;
+
+void
+binder_nfc_histogram_add(
+    BinderNfcHistogram* hist,
+    gint64 us)
+    G_GNUC_INTERNAL;
+
+gint64
+binder_nfc_histogram_average(
+    const BinderNfcHistogram* hist)
+    G_GNUC_INTERNAL;
+
+gint64
+binder_nfc_histogram_percentile(
+    const BinderNfcHistogram* hist,
+    guint permille)
+    G_GNUC_INTERNAL;
+
+/* Rolling window of the most recent samples */
+
+#define BINDER_NFC_WINDOW_SIZE (32)
+
+typedef struct binder_nfc_window {
+    guint count;
+    guint next;
+    gint64 sample[BINDER_NFC_WINDOW_SIZE];
+} BinderNfcWindow;
+
+void
+binder_nfc_window_add(
+    BinderNfcWindow* window,
+    gint64 value)
+    G_GNUC_INTERNAL;
+
+gint64
+binder_nfc_window_percentile(
+    const BinderNfcWindow* window,
+    guint permille)
+    G_GNUC_INTERNAL;
+
+#endif /* BINDER_NFC_STATS_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#include "binder_nfc_timeline.h"
+
+#include <string.h>
+
+static const char* binder_nfc_power_phase_names[] = {
+    "request",
+    "open",
+    "OPEN_CPLT",
+    "close",
+    "CLOSE_CPLT",
+    "notify",
+    "coreInitialized",
+    "prediscover"
+};
+
+G_STATIC_ASSERT(G_N_ELEMENTS(binder_nfc_power_phase_names) ==
+    BINDER_NFC_POWER_PHASES);
+
+#define MS(us) ((us) / 1000.0)
+
+/*==========================================================================*
+ * Implementation
+ *==========================================================================*/
+
+static
+void
+binder_nfc_timeline_dump_cycle(
+    const BinderNfcPowerCycle* cycle,
+    const char* name,
+    const char* state)
+{
+    const gint64 t0 = cycle->time[BINDER_NFC_POWER_PHASE_REQUEST];
+    GString* buf = g_string_new(NULL);
+    guint i;
+
+    for (i = BINDER_NFC_POWER_PHASE_REQUEST + 1; i < BINDER_NFC_POWER_PHASES;
+         i++) {
+        if (cycle->time[i]) {
+            g_string_append_printf(buf, " %s +%.1f",
+                binder_nfc_power_phase_names[i], MS(cycle->time[i] - t0));
+        }
+    }
+    GINFO("%s power %s%s:%s ms", name, cycle->on ? "on" : "off", state,
+        buf->len ? buf->str : " -");
+    g_string_free(buf, TRUE);
+}
+
+/*==========================================================================*
+ * API
+ *==========================================================================*/
+
+void
+binder_nfc_timeline_start(
+    BinderNfcTimeline* self,
+    gboolean on)
+{
+    binder_nfc_timeline_finish(self);
+    memset(&self->current, 0, sizeof(self->current));
+    self->current.on = on;
+    self->current.time[BINDER_NFC_POWER_PHASE_REQUEST] =
+        g_get_monotonic_time();
+    self->active = TRUE;
+}
+
+void
+binder_nfc_timeline_mark(
+    BinderNfcTimeline* self,
+    BINDER_NFC_POWER_PHASE phase)
+{
+    if (self->active && !self->current.time[phase]) {
+        self->current.time[phase] = g_get_monotonic_time();
+
+        /*
+         * Power on is done when discovery starts, power off when
+         * nfcd gets notified.
+         */
+        if (phase == (self->current.on ?
+            BINDER_NFC_POWER_PHASE_PREDISCOVER :
+            BINDER_NFC_POWER_PHASE_NOTIFY)) {
+            binder_nfc_timeline_finish(self);
+        }
+    }
+}
+
+void
+binder_nfc_timeline_finish(
+    BinderNfcTimeline* self)
+{
+    if (self->active) {
+        const BinderNfcPowerCycle* cycle = &self->current;
+        const gint64 t0 = cycle->time[BINDER_NFC_POWER_PHASE_REQUEST];
+        BinderNfcWindow* window = self->window[cycle->on ? 1 : 0];
+        guint i;
+
+        for (i = BINDER_NFC_POWER_PHASE_REQUEST + 1;
+             i < BINDER_NFC_POWER_PHASES; i++) {
+            if (cycle->time[i]) {
+                binder_nfc_window_add(window + i, cycle->time[i] - t0);
+            }
+        }
+        self->history[self->count % BINDER_NFC_TIMELINE_HISTORY] = *cycle;
+        self->count++;
+        self->active = FALSE;
+    }
+}
+
+void
+binder_nfc_timeline_dump(
+    const BinderNfcTimeline* self,
+    const char* name)
+{
+    const guint n = MIN(self->count, BINDER_NFC_TIMELINE_HISTORY);
+    guint i, on;
+
+    /* Recent power switches, oldest first */
+    for (i = self->count - n; i < self->count; i++) {
+        binder_nfc_timeline_dump_cycle(self->history +
+            (i % BINDER_NFC_TIMELINE_HISTORY), name, "");
+    }
+    if (self->active) {
+        binder_nfc_timeline_dump_cycle(&self->current, name,
+            " (in progress)");
+    }
+
+    /* Rolling percentiles */
+    for (on = 0; on < 2; on++) {
+        for (i = BINDER_NFC_POWER_PHASE_REQUEST + 1;
+             i < BINDER_NFC_POWER_PHASES; i++) {
+            const BinderNfcWindow* window = self->window[on] + i;
+
+            if (window->count) {
+                GINFO("%s power %s %s: p50 %.1f p90 %.1f max %.1f ms "
+                    "(last %u)", name, on ? "on" : "off",
+                    binder_nfc_power_phase_names[i],
+                    MS(binder_nfc_window_percentile(window, 500)),
+                    MS(binder_nfc_window_percentile(window, 900)),
+                    MS(binder_nfc_window_percentile(window, 1000)),
+                    window->count);
+            }
+        }
+    }
+}
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
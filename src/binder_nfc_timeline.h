@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_TIMELINE_H
+#define BINDER_NFC_TIMELINE_H
+
+#include "binder_nfc_stats.h"
+
+/* Timestamps of the power switch phases */
+
+typedef enum binder_nfc_power_phase {
+    BINDER_NFC_POWER_PHASE_REQUEST,         /* submit_power_request */
+    BINDER_NFC_POWER_PHASE_OPEN,            /* open() reply */
+    BINDER_NFC_POWER_PHASE_OPEN_CPLT,       /* OPEN_CPLT event */
+    BINDER_NFC_POWER_PHASE_CLOSE,           /* close() reply */
+    BINDER_NFC_POWER_PHASE_CLOSE_CPLT,      /* CLOSE_CPLT event */
+    BINDER_NFC_POWER_PHASE_NOTIFY,          /* nfc_adapter_power_notify */
+    BINDER_NFC_POWER_PHASE_CORE_INITIALIZED,/* Reply or POST_INIT_CPLT */
+    BINDER_NFC_POWER_PHASE_PREDISCOVER,     /* Reply or PRE_DISCOVER_CPLT */
+    BINDER_NFC_POWER_PHASES
+} BINDER_NFC_POWER_PHASE;
+
+#define BINDER_NFC_TIMELINE_HISTORY (8)
+
+typedef struct binder_nfc_power_cycle {
+    gboolean on;
+    gint64 time[BINDER_NFC_POWER_PHASES]; /* Zero if it didn't happen */
+} BinderNfcPowerCycle;
+
+typedef struct binder_nfc_timeline {
+    gboolean active;
+    BinderNfcPowerCycle current;
+    guint count;
+    BinderNfcPowerCycle history[BINDER_NFC_TIMELINE_HISTORY];
+    /* Time since the request, indexed by [on][phase] */
+    BinderNfcWindow window[2][BINDER_NFC_POWER_PHASES];
+} BinderNfcTimeline;
+
+void
+binder_nfc_timeline_start(
+    BinderNfcTimeline* timeline,
+    gboolean on)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_timeline_mark(
+    BinderNfcTimeline* timeline,
+    BINDER_NFC_POWER_PHASE phase)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_timeline_finish(
+    BinderNfcTimeline* timeline)
+    G_GNUC_INTERNAL;
+
+void
+binder_nfc_timeline_dump(
+    const BinderNfcTimeline* timeline,
+    const char* name)
+    G_GNUC_INTERNAL;
+
+#endif /* BINDER_NFC_TIMELINE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2026 Slava Monich <slava@monich.com>
+ *
+ * You may use this file under the terms of the BSD license as follows:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer
+ *     in the documentation and/or other materials provided with the
+ *     distribution.
+ *
+ *  3. Neither the names of the copyright holders nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDERS OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * The views and conclusions contained in the software and documentation
+ * are those of the authors and should not be interpreted as representing
+ * any official policies, either expressed or implied.
+ */
+
+#ifndef BINDER_NFC_TRACE_H
+#define BINDER_NFC_TRACE_H
+
+/*
+ * Static tracepoints for perf/bpftrace, e.g.
+ *
+ *   bpftrace -e 'usdt:/usr/lib/nfcd/plugins/binder.so:binder_nfc:* {...}'
+ *
+ * Compiled in with "make ENABLE_USDT=1", cost nothing unless attached.
+ */
+
+#ifdef ENABLE_USDT
+#  include <sys/sdt.h>
+#  define BINDER_TRACE1(name,a) \
+    DTRACE_PROBE1(binder_nfc, name, a)
+#  define BINDER_TRACE2(name,a,b) \
+    DTRACE_PROBE2(binder_nfc, name, a, b)
+#  define BINDER_TRACE3(name,a,b,c) \
+    DTRACE_PROBE3(binder_nfc, name, a, b, c)
+#else
+#  define BINDER_TRACE1(name,a) ((void)0)
+#  define BINDER_TRACE2(name,a,b) ((void)0)
+#  define BINDER_TRACE3(name,a,b,c) ((void)0)
+#endif /* ENABLE_USDT */
+
+#endif /* BINDER_NFC_TRACE_H */
+
+/*
+ * Local Variables:
+ * mode: C
+ * c-basic-offset: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
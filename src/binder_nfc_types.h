@@ -48,8 +48,13 @@ extern GLogModule binder_hexdump_log;
 #include <nfc_types.h>
 #include <gbinder_types.h>
 
+/* NCI packet header and the largest packet (header + 255 bytes) */
+#define BINDER_NFC_NCI_HEADER_SIZE (3)
+#define BINDER_NFC_NCI_PACKET_MAX (258)
+
 /* Abstract NFC binder API */
 typedef struct binder_nfc_api BinderNfcApi;
+typedef struct binder_nfc_config BinderNfcConfig;
 typedef struct binder_nfc_backend {
     const char* name;   /* Backend name for logging purposes */
     const char* dev;    /* Binder device */
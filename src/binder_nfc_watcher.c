@@ -42,6 +42,8 @@
 
 #include <gutil_misc.h>
 
+#include <string.h>
+
 typedef GObjectClass BinderNfcWatcherObjectClass;
 typedef struct binder_nfc_watcher_object {
     BinderNfcWatcher pub;
@@ -49,6 +51,9 @@ typedef struct binder_nfc_watcher_object {
     GBinderServiceManager* sm;
     gulong name_watch_id;
     gulong list_call_id;
+    GHashTable* registered;  /* Names waiting for registration_proc */
+    gboolean list_needed;    /* Full list is needed to make sense of it */
+    guint registration_id;   /* Idle source coalescing the notifications */
 } BinderNfcWatcherObject;
 
 typedef struct binder_nfc_watcher_service_entry {
@@ -132,6 +137,9 @@ binder_nfc_watcher_service_get_reply(
             [SIGNAL_SERVICE_FOUND], 0, remote, entry->fqname);
     } else {
         GWARN("Couldn't get remote handle to %s", entry->fqname);
+
+        /* Let the next registration notification try again */
+        g_hash_table_remove(entry->obj->services, entry->fqname);
     }
 }
 
@@ -166,18 +174,12 @@ binder_nfc_watcher_service_list_proc(
     self->list_call_id = 0;
     if (services) {
         const BinderNfcBackend* backend = self->pub.backend;
-        const gsize prefix_len = strlen(backend->watch);
         char** ptr;
 
         for (ptr = services; *ptr; ptr++) {
             const char* fqname = *ptr;
 
-            /*
-             * Accept either the full match or a partial match with a suffix
-             * beginning with a slash.
-             */
-            if (g_str_has_prefix(fqname, backend->watch) &&
-               (!fqname[prefix_len] || fqname[prefix_len] == '/')) {
+            if (binder_nfc_watcher_name_match(backend->watch, fqname)) {
                 binder_nfc_watcher_service_found(self, fqname);
             }
         }
@@ -185,6 +187,33 @@ binder_nfc_watcher_service_list_proc(
     return FALSE; /* Free the service list */
 }
 
+static
+gboolean
+binder_nfc_watcher_registration_proc(
+    gpointer watcher)
+{
+    BinderNfcWatcherObject* self = THIS(watcher);
+    GHashTableIter it;
+    gpointer key;
+
+    self->registration_id = 0;
+    if (self->list_needed) {
+        GBinderServiceManager* sm = self->sm;
+
+        self->list_needed = FALSE;
+        self->pub.list_calls++;
+        gbinder_servicemanager_cancel(sm, self->list_call_id);
+        self->list_call_id = gbinder_servicemanager_list(sm,
+            binder_nfc_watcher_service_list_proc, self);
+    }
+    g_hash_table_iter_init(&it, self->registered);
+    while (g_hash_table_iter_next(&it, &key, NULL)) {
+        binder_nfc_watcher_service_found(self, key);
+        g_hash_table_iter_remove(&it);
+    }
+    return G_SOURCE_REMOVE;
+}
+
 static
 void
 binder_nfc_watcher_registration_handler(
@@ -194,9 +223,22 @@ binder_nfc_watcher_registration_handler(
 {
     BinderNfcWatcherObject* self = THIS(watcher);
 
-    gbinder_servicemanager_cancel(sm, self->list_call_id);
-    self->list_call_id = gbinder_servicemanager_list(sm,
-        binder_nfc_watcher_service_list_proc, self);
+    /*
+     * The registered name can usually be resolved directly, without
+     * fetching (and scanning) the list of all services. Notifications
+     * coming in bursts are handled together, from an idle callback.
+     */
+    self->pub.notifications++;
+    if (binder_nfc_watcher_name_match(self->pub.backend->watch, name)) {
+        g_hash_table_add(self->registered, g_strdup(name));
+    } else {
+        GDEBUG("Unexpected registration %s", name);
+        self->list_needed = TRUE;
+    }
+    if (!self->registration_id) {
+        self->registration_id =
+            g_idle_add(binder_nfc_watcher_registration_proc, self);
+    }
 }
 
 /*==========================================================================*
@@ -214,6 +256,7 @@ binder_nfc_watcher_new(
         BinderNfcWatcher* watcher = &self->pub;
 
         watcher->backend = backend;
+        watcher->list_calls++;
         self->sm = sm;
         self->list_call_id = gbinder_servicemanager_list
             (sm, binder_nfc_watcher_service_list_proc, self);
@@ -235,6 +278,21 @@ binder_nfc_watcher_add_handler(
         G_CALLBACK(func), user_data) : 0;
 }
 
+gboolean
+binder_nfc_watcher_name_match(
+    const char* watch,
+    const char* fqname)
+{
+    const gsize len = strlen(watch);
+
+    /*
+     * Accept either the full match or a partial match with a suffix
+     * beginning with a slash.
+     */
+    return !strncmp(fqname, watch, len) &&
+        (!fqname[len] || fqname[len] == '/');
+}
+
 /*==========================================================================*
  * Internals
  *==========================================================================*/
@@ -246,6 +304,8 @@ binder_nfc_watcher_object_init(
 {
     self->services = g_hash_table_new_full(g_str_hash, g_str_equal,
         NULL, binder_nfc_watcher_service_entry_free);
+    self->registered = g_hash_table_new_full(g_str_hash, g_str_equal,
+        g_free, NULL);
 }
 
 static
@@ -255,6 +315,10 @@ binder_nfc_watcher_object_finalize(
 {
     BinderNfcWatcherObject* self = THIS(object);
 
+    if (self->registration_id) {
+        g_source_remove(self->registration_id);
+    }
+    g_hash_table_destroy(self->registered);
     g_hash_table_destroy(self->services);
     gbinder_servicemanager_remove_handler(self->sm, self->name_watch_id);
     gbinder_servicemanager_cancel(self->sm, self->list_call_id);
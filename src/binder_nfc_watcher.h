@@ -46,6 +46,8 @@
 typedef struct binder_nfc_watcher {
     GObject object;
     const BinderNfcBackend* backend;
+    guint notifications;  /* Registration notifications received */
+    guint list_calls;     /* Number of times the service list was fetched */
 } BinderNfcWatcher;
 
 typedef
@@ -68,6 +70,12 @@ binder_nfc_watcher_add_handler(
     void* user_data)
     G_GNUC_INTERNAL;
 
+gboolean
+binder_nfc_watcher_name_match(
+    const char* watch,
+    const char* fqname)
+    G_GNUC_INTERNAL;
+
 #endif /* BINDER_NFC_WATCHER_H */
 
 /*